@@ -0,0 +1,239 @@
+/*
+ ============================================================================
+ Name        : bench-io.c
+ Author      : Eduardo Ribeiro
+ Description : Runs create-hdf5-dataset with each write strategy over a grid
+               of dataset shapes and writes throughput, file size and peak
+               memory as CSV
+ ============================================================================
+ */
+
+#include "utils/clock.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/**
+ * Longest command line of a run
+ */
+#define BENCH_MAX_ARGS 32
+
+/**
+ * Every run draws the same lines
+ */
+#define BENCH_SEED "1"
+
+/**
+ * Lines per chunk of the chunked strategies
+ */
+#define BENCH_CHUNK_LINES "--chunk-lines=1024"
+
+/**
+ * Write strategy: the options it adds to the command line
+ */
+typedef struct strategy_t {
+	const char* name;
+	const char* options[4];
+} strategy_t;
+
+static const strategy_t strategies[] = {
+	{ "per-line", { "--per-line", NULL } },
+	{ "per-line-writer", { "--per-line-writer", NULL } },
+	{ "block", { NULL } },
+	{ "chunked", { BENCH_CHUNK_LINES, NULL } },
+	{ "compressed", { BENCH_CHUNK_LINES, "-z", "6", NULL } },
+	{ "direct-chunk",
+	  { BENCH_CHUNK_LINES, "-z", "6", "--direct-chunks" } },
+	{ "core", { "--in-memory", NULL } },
+};
+
+static const char* observations[] = { "20000", "200000" };
+static const char* attributes[] = { "1000", "20000" };
+static const char* densities[] = { "3", "26" };
+
+/**
+ * Result of one run
+ */
+typedef struct run_t {
+	int status;
+	double seconds;
+	double write_mb_s;
+	uint64_t bytes;
+	uint64_t file_bytes;
+	long max_rss_kb;
+} run_t;
+
+/**
+ * Reads a number from the JSON summary written by --metrics-json
+ */
+static double json_number(const char* text, const char* key)
+{
+	char pattern[64];
+	snprintf(pattern, sizeof(pattern), "\"%s\": ", key);
+
+	const char* found = strstr(text, pattern);
+	if (found == NULL) {
+		return 0.0;
+	}
+
+	return strtod(found + strlen(pattern), NULL);
+}
+
+/**
+ * Runs the generator once and waits for it
+ */
+static void run_generator(char* const* argv, const char* filename,
+						  const char* metrics, run_t* run)
+{
+	struct rusage usage;
+	int status = 0;
+
+	run->status = -1;
+	run->seconds = 0.0;
+	run->write_mb_s = 0.0;
+	run->bytes = 0;
+	run->file_bytes = 0;
+	run->max_rss_kb = 0;
+
+	uint64_t start = clock_ns();
+
+	pid_t pid = fork();
+	if (pid == 0) {
+		// Only the CSV goes to stdout
+		if (freopen("/dev/null", "w", stdout) == NULL) {
+			_exit(127);
+		}
+		execv(argv[0], argv);
+		_exit(127);
+	}
+
+	if (pid < 0 || wait4(pid, &status, 0, &usage) != pid) {
+		fprintf(stderr, "Error running %s\n", argv[0]);
+		return;
+	}
+
+	run->seconds = (double) (clock_ns() - start) / 1e9;
+	run->status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+	run->max_rss_kb = usage.ru_maxrss;
+
+	struct stat info;
+	if (stat(filename, &info) == 0) {
+		run->file_bytes = (uint64_t) info.st_size;
+	}
+
+	FILE* file = fopen(metrics, "r");
+	if (file != NULL) {
+		char text[4096];
+		size_t size = fread(text, 1, sizeof(text) - 1, file);
+		text[size] = '\0';
+		fclose(file);
+
+		run->write_mb_s = json_number(text, "mb_per_s");
+		run->bytes = (uint64_t) json_number(text, "bytes");
+	}
+
+	remove(filename);
+	remove(metrics);
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2 || argc > 4) {
+		fprintf(stderr,
+				"Usage: %s generator [directory for the files] [CSV file]\n",
+				argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	const char* directory = argc > 2 ? argv[2] : ".";
+
+	FILE* csv = stdout;
+	if (argc > 3) {
+		csv = fopen(argv[3], "w");
+		if (csv == NULL) {
+			fprintf(stderr, "Error creating %s\n", argv[3]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	char filename[4096];
+	char metrics[4096];
+	char metrics_option[4200];
+
+	snprintf(filename, sizeof(filename), "%s/bench-io.h5", directory);
+	snprintf(metrics, sizeof(metrics), "%s/bench-io.json", directory);
+	snprintf(metrics_option, sizeof(metrics_option), "--metrics-json=%s",
+			 metrics);
+
+	// Leftovers from an interrupted run would stop the generator
+	remove(filename);
+
+	fprintf(csv, "strategy,observations,attributes,density,status,seconds,"
+				 "mb_per_s,write_mb_per_s,file_mb,max_rss_mb\n");
+
+	size_t n_observations = sizeof(observations) / sizeof(observations[0]);
+	size_t n_attributes = sizeof(attributes) / sizeof(attributes[0]);
+	size_t n_densities = sizeof(densities) / sizeof(densities[0]);
+	size_t n_strategies = sizeof(strategies) / sizeof(strategies[0]);
+
+	for (size_t o = 0; o < n_observations; o++) {
+		for (size_t a = 0; a < n_attributes; a++) {
+			for (size_t d = 0; d < n_densities; d++) {
+				for (size_t s = 0; s < n_strategies; s++) {
+					const char* args[BENCH_MAX_ARGS];
+					int n_args = 0;
+
+					args[n_args++] = argv[1];
+					args[n_args++] = "-f";
+					args[n_args++] = filename;
+					args[n_args++] = "-d";
+					args[n_args++] = "dataset";
+					args[n_args++] = "-o";
+					args[n_args++] = observations[o];
+					args[n_args++] = "-a";
+					args[n_args++] = attributes[a];
+					args[n_args++] = "-p";
+					args[n_args++] = densities[d];
+					args[n_args++] = "-s";
+					args[n_args++] = BENCH_SEED;
+					args[n_args++] = metrics_option;
+
+					for (int i = 0; i < 4 && strategies[s].options[i] != NULL;
+						 i++) {
+						args[n_args++] = strategies[s].options[i];
+					}
+					args[n_args] = NULL;
+
+					run_t run;
+					run_generator((char* const*) args, filename, metrics,
+								  &run);
+
+					double mb = (double) run.bytes / (1024 * 1024);
+
+					fprintf(csv, "%s,%s,%s,%s,%d,%.3f,%.1f,%.1f,%.1f,%.1f\n",
+							strategies[s].name, observations[o],
+							attributes[a], densities[d], run.status,
+							run.seconds,
+							run.seconds > 0 ? mb / run.seconds : 0.0,
+							run.write_mb_s,
+							(double) run.file_bytes / (1024 * 1024),
+							(double) run.max_rss_kb / 1024);
+					fflush(csv);
+				}
+			}
+		}
+	}
+
+	if (csv != stdout) {
+		fclose(csv);
+	}
+
+	return EXIT_SUCCESS;
+}
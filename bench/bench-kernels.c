@@ -0,0 +1,396 @@
+/*
+ ============================================================================
+ Name        : bench-kernels.c
+ Author      : Eduardo Ribeiro
+ Description : Times the dataset and bit kernels over a range of line widths
+               and numbers of classes
+ ============================================================================
+ */
+
+#include "column.h"
+#include "dataset.h"
+#include "types/dataset_t.h"
+#include "types/oknok_t.h"
+#include "types/sampler_t.h"
+#include "types/word_t.h"
+#include "utils/alias.h"
+#include "utils/bit.h"
+#include "utils/clock.h"
+#include "utils/random.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Data per configuration, in MB, unless given on the command line
+ */
+#define BENCH_MB_DEFAULT 16
+
+/**
+ * Each kernel runs this many times and the fastest run counts
+ */
+#define BENCH_REPEATS 5
+
+/**
+ * Probability of a bit being set, in percent
+ */
+#define BENCH_DENSITY 26
+
+/**
+ * Kernels skip nothing: their results end up here
+ */
+static volatile uint64_t sink;
+
+/**
+ * Configuration being timed
+ */
+typedef struct bench_t {
+	dataset_t dataset;
+	sampler_t sampler;
+
+	/**
+	 * Copy of the data, so comparisons scan whole lines
+	 */
+	word_t* copy;
+
+	/**
+	 * Every line twice, for remove_duplicates
+	 */
+	word_t* pairs;
+	word_t* pairs_work;
+
+	/**
+	 * Attribute-major copy of the data
+	 */
+	word_t* columns;
+} bench_t;
+
+static void bench_fill_buffer(bench_t* bench)
+{
+	dataset_t* dataset = &bench->dataset;
+	word_t* line = dataset->data;
+
+	for (uint64_t i = 0; i < dataset->n_observations; i++) {
+		fill_buffer(dataset, &bench->sampler, i, line);
+		NEXT_LINE(line, dataset->n_words);
+	}
+}
+
+static void bench_get_class(bench_t* bench)
+{
+	dataset_t* dataset = &bench->dataset;
+	word_t* line = dataset->data;
+	uint64_t total = 0;
+
+	for (uint32_t i = 0; i < dataset->n_observations; i++) {
+		total += get_class(line, dataset->n_attributes, dataset->n_words,
+						   dataset->n_bits_for_class);
+		NEXT_LINE(line, dataset->n_words);
+	}
+
+	sink = total;
+}
+
+static void bench_get_classes(bench_t* bench)
+{
+	dataset_t* dataset = &bench->dataset;
+	uint32_t classes[CLASS_BATCH_LINES];
+	uint64_t total = 0;
+
+	for (uint32_t first = 0; first < dataset->n_observations;
+		 first += CLASS_BATCH_LINES) {
+		uint32_t n_lines = dataset->n_observations - first;
+
+		if (n_lines > CLASS_BATCH_LINES) {
+			n_lines = CLASS_BATCH_LINES;
+		}
+
+		get_classes(&dataset->layout,
+					dataset->data + (uint64_t) first * dataset->n_words,
+					n_lines, classes);
+
+		for (uint32_t i = 0; i < n_lines; i++) {
+			total += classes[i];
+		}
+	}
+
+	sink = total;
+}
+
+static void bench_set_class_bits(bench_t* bench)
+{
+	dataset_t* dataset = &bench->dataset;
+	word_t* line = bench->copy;
+
+	for (uint32_t i = 0; i < dataset->n_observations; i++) {
+		set_class_bits(line, i % dataset->n_classes, dataset->n_attributes,
+					   dataset->n_words, dataset->n_bits_for_class);
+		NEXT_LINE(line, dataset->n_words);
+	}
+}
+
+static void bench_compare_lines_extra(bench_t* bench)
+{
+	dataset_t* dataset = &bench->dataset;
+	word_t* a = dataset->data;
+	word_t* b = bench->copy;
+	int64_t total = 0;
+
+	for (uint32_t i = 0; i < dataset->n_observations; i++) {
+		total += compare_lines_extra(a, b, &dataset->n_words);
+		NEXT_LINE(a, dataset->n_words);
+		NEXT_LINE(b, dataset->n_words);
+	}
+
+	sink = (uint64_t) total;
+}
+
+static void bench_has_same_attributes(bench_t* bench)
+{
+	dataset_t* dataset = &bench->dataset;
+	word_t* a = dataset->data;
+	word_t* b = bench->copy;
+	uint64_t total = 0;
+
+	for (uint32_t i = 0; i < dataset->n_observations; i++) {
+		total += has_same_attributes(a, b, dataset->n_attributes);
+		NEXT_LINE(a, dataset->n_words);
+		NEXT_LINE(b, dataset->n_words);
+	}
+
+	sink = total;
+}
+
+static void bench_remove_duplicates(bench_t* bench)
+{
+	dataset_t pairs = bench->dataset;
+
+	pairs.data = bench->pairs_work;
+	pairs.n_observations = 2 * bench->dataset.n_observations;
+
+	sink = remove_duplicates(&pairs);
+}
+
+static void bench_fill_class_arrays(bench_t* bench)
+{
+	dataset_t* dataset = &bench->dataset;
+
+	memset(dataset->n_observations_per_class, 0,
+		   sizeof(uint32_t) * dataset->n_classes);
+
+	fill_class_arrays(dataset);
+}
+
+static void bench_transpose64(bench_t* bench)
+{
+	dataset_t* dataset = &bench->dataset;
+
+	// A tile is 64 words
+	uint64_t n_tiles
+		= (uint64_t) dataset->n_observations * dataset->n_words / 64;
+
+	for (uint64_t i = 0; i < n_tiles; i++) {
+		transpose64(bench->copy + i * 64);
+	}
+}
+
+static void bench_column_transpose(bench_t* bench)
+{
+	dataset_t* dataset = &bench->dataset;
+
+	column_transpose(dataset->data, dataset->n_observations, dataset->n_words,
+					 dataset->n_attributes, bench->columns);
+}
+
+/**
+ * Kernels in the order they are timed
+ */
+typedef struct kernel_t {
+	const char* name;
+	void (*run)(bench_t* bench);
+
+	/**
+	 * Restores the input before each run, untimed
+	 */
+	void (*reset)(bench_t* bench);
+} kernel_t;
+
+static void reset_copy(bench_t* bench)
+{
+	memcpy(bench->copy, bench->dataset.data,
+		   sizeof(word_t) * bench->dataset.n_observations
+			   * bench->dataset.n_words);
+}
+
+static void reset_pairs(bench_t* bench)
+{
+	memcpy(bench->pairs_work, bench->pairs,
+		   sizeof(word_t) * 2 * bench->dataset.n_observations
+			   * bench->dataset.n_words);
+}
+
+static const kernel_t kernels[] = {
+	{ "fill_buffer", bench_fill_buffer, NULL },
+	{ "get_class", bench_get_class, NULL },
+	{ "get_classes", bench_get_classes, NULL },
+	{ "set_class_bits", bench_set_class_bits, reset_copy },
+	{ "compare_lines_extra", bench_compare_lines_extra, reset_copy },
+	{ "has_same_attributes", bench_has_same_attributes, reset_copy },
+	{ "remove_duplicates", bench_remove_duplicates, reset_pairs },
+	{ "fill_class_arrays", bench_fill_class_arrays, NULL },
+	{ "transpose64", bench_transpose64, reset_copy },
+	{ "column_transpose", bench_column_transpose, NULL },
+};
+
+/**
+ * Allocates and fills a dataset of about mb MB
+ */
+static int bench_init(bench_t* bench, const uint32_t n_attributes,
+					  const uint32_t n_classes, const double mb)
+{
+	dataset_t* dataset = &bench->dataset;
+
+	init_dataset(dataset);
+	dataset->n_attributes = n_attributes;
+	dataset->n_classes = n_classes;
+	dataset->n_bits_for_class = (uint8_t) ceil(log2(n_classes));
+
+	uint32_t total_bits = n_attributes + dataset->n_bits_for_class;
+	dataset->n_words = total_bits / WORD_BITS + (total_bits % WORD_BITS != 0);
+
+	line_layout_init(&dataset->layout, n_attributes, dataset->n_words,
+					 dataset->n_bits_for_class);
+
+	// Whole 64 x 64 tiles for transpose64
+	uint64_t n_lines
+		= (uint64_t) (mb * 1024 * 1024) / (sizeof(word_t) * dataset->n_words);
+	n_lines = (n_lines + 63) / 64 * 64;
+	dataset->n_observations = (uint32_t) n_lines;
+
+	size_t size = sizeof(word_t) * n_lines * dataset->n_words;
+
+	dataset->data = (word_t*) malloc(size);
+	dataset->n_observations_per_class
+		= (uint32_t*) calloc(n_classes, sizeof(uint32_t));
+	dataset->observations_per_class
+		= (word_t**) malloc(sizeof(word_t*) * n_classes * n_lines);
+	bench->copy = (word_t*) malloc(size);
+	bench->pairs = (word_t*) malloc(2 * size);
+	bench->pairs_work = (word_t*) malloc(2 * size);
+	bench->columns = (word_t*) malloc(sizeof(word_t) * n_attributes
+									  * column_words(n_lines));
+
+	bench->sampler.seed = 1;
+	bernoulli_init(&bench->sampler.bernoulli, BENCH_DENSITY);
+	oknok_t status = alias_init(&bench->sampler.classes, NULL, n_classes);
+
+	if (status != OK || dataset->data == NULL
+		|| dataset->n_observations_per_class == NULL
+		|| dataset->observations_per_class == NULL || bench->copy == NULL
+		|| bench->pairs == NULL || bench->pairs_work == NULL
+		|| bench->columns == NULL) {
+		fprintf(stderr, "Error allocating %lu lines\n", n_lines);
+		return EXIT_FAILURE;
+	}
+
+	bench_fill_buffer(bench);
+
+	// Duplicates are next to each other, as after sorting
+	for (uint64_t i = 0; i < n_lines; i++) {
+		word_t* line = dataset->data + i * dataset->n_words;
+		word_t* pair = bench->pairs + 2 * i * dataset->n_words;
+
+		memcpy(pair, line, sizeof(word_t) * dataset->n_words);
+		memcpy(pair + dataset->n_words, line,
+			   sizeof(word_t) * dataset->n_words);
+	}
+
+	return EXIT_SUCCESS;
+}
+
+static void bench_free(bench_t* bench)
+{
+	free_dataset(&bench->dataset);
+	alias_free(&bench->sampler.classes);
+	free(bench->copy);
+	free(bench->pairs);
+	free(bench->pairs_work);
+	free(bench->columns);
+}
+
+/**
+ * Times every kernel and prints ns per line and GB/s of line data
+ */
+static void bench_run(bench_t* bench)
+{
+	dataset_t* dataset = &bench->dataset;
+	double line_bytes = (double) (sizeof(word_t) * dataset->n_words);
+
+	for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+		uint64_t best = UINT64_MAX;
+
+		for (int r = 0; r < BENCH_REPEATS; r++) {
+			if (kernels[k].reset != NULL) {
+				kernels[k].reset(bench);
+			}
+
+			uint64_t start = clock_ns();
+			kernels[k].run(bench);
+			uint64_t elapsed = clock_ns() - start;
+
+			if (elapsed < best) {
+				best = elapsed;
+			}
+		}
+
+		double ns_line = (double) best / dataset->n_observations;
+
+		fprintf(stdout, "%-20s %10u %8u %10u %12.2f %8.2f\n", kernels[k].name,
+				dataset->n_attributes, dataset->n_classes,
+				dataset->n_observations, ns_line, line_bytes / ns_line);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	static const uint32_t attributes[] = { 64, 500, 4000, 20000, 100000 };
+	static const uint32_t classes[] = { 2, 5, 32 };
+
+	double mb = BENCH_MB_DEFAULT;
+
+	if (argc > 1) {
+		mb = strtod(argv[1], NULL);
+	}
+
+	if (argc > 2 || mb <= 0) {
+		fprintf(stderr, "Usage: %s [MB per configuration]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	fprintf(stdout,
+			"# %s random kernel, %s transpose kernel, %.0f MB per "
+			"configuration, best of %d runs\n",
+			rng_kernel(), transpose64_kernel(), mb, BENCH_REPEATS);
+	fprintf(stdout, "%-20s %10s %8s %10s %12s %8s\n", "kernel", "attributes",
+			"classes", "lines", "ns/line", "GB/s");
+
+	for (size_t a = 0; a < sizeof(attributes) / sizeof(attributes[0]); a++) {
+		for (size_t c = 0; c < sizeof(classes) / sizeof(classes[0]); c++) {
+			bench_t bench;
+
+			if (bench_init(&bench, attributes[a], classes[c], mb)
+				!= EXIT_SUCCESS) {
+				bench_free(&bench);
+				return EXIT_FAILURE;
+			}
+
+			bench_run(&bench);
+			bench_free(&bench);
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,223 @@
+/*
+ ============================================================================
+ Name        : check-layout.c
+ Author      : Eduardo Ribeiro
+ Description : Checks that the class of a line reads back as it was written,
+               most of all when the class bits are split between two words
+ ============================================================================
+ */
+
+#include "dataset.h"
+#include "types/dataset_t.h"
+#include "types/line_layout_t.h"
+#include "types/oknok_t.h"
+#include "types/word_t.h"
+#include "utils/bit.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Lines per check, more than a batch of fill_class_arrays
+ */
+#define CHECK_LINES (CLASS_BATCH_LINES + 77)
+
+/**
+ * Numbers of attributes that leave 62 or 63 bits on the last attribute word,
+ * so the class bits may start on one word and end on the next
+ */
+static const uint32_t attributes[] = { 62, 63, 126, 127, 1022, 1023 };
+
+/**
+ * Numbers of classes: 1, 3 and 5 class bits
+ */
+static const uint32_t classes[] = { 2, 5, 32 };
+
+/**
+ * Values the attribute and padding bits start with
+ */
+static const word_t fills[] = { 0, ~(word_t) 0, 0xA5A5A5A5A5A5A5A5 };
+
+/**
+ * Reads the class one bit at a time: its bits follow the attributes, most
+ * significant first, and the bits of a word are numbered from the most
+ * significant too
+ */
+static uint32_t reference_class(const word_t* line,
+								const uint32_t n_attributes,
+								const uint8_t n_bits_for_class)
+{
+	uint32_t line_class = 0;
+
+	for (uint32_t b = n_attributes; b < n_attributes + n_bits_for_class;
+		 b++) {
+		word_t bit = (line[b / WORD_BITS] >> (WORD_BITS - 1 - b % WORD_BITS))
+			& 1;
+
+		line_class = (line_class << 1) | (uint32_t) bit;
+	}
+
+	return line_class;
+}
+
+/**
+ * Sets the class of every line with line_set_class and reads them back with
+ * line_get_class, get_class, get_classes, fill_class_arrays and bit by bit.
+ * Setting the class the fill decodes to must give back the fill, so no
+ * other bit changed
+ */
+static int check_round_trip(const uint32_t n_attributes,
+							const uint32_t n_classes, const word_t fill)
+{
+	dataset_t dataset;
+	init_dataset(&dataset);
+
+	dataset.n_attributes = n_attributes;
+	dataset.n_classes = n_classes;
+	dataset.n_bits_for_class = (uint8_t) ceil(log2(n_classes));
+	dataset.n_observations = CHECK_LINES;
+
+	uint32_t total_bits = n_attributes + dataset.n_bits_for_class;
+	dataset.n_words = total_bits / WORD_BITS + (total_bits % WORD_BITS != 0);
+
+	uint32_t n_words = dataset.n_words;
+
+	line_layout_t layout;
+	line_layout_init(&layout, n_attributes, n_words, dataset.n_bits_for_class);
+
+	// One more line, that nothing should write to
+	dataset.data
+		= (word_t*) malloc(sizeof(word_t) * (CHECK_LINES + 1) * n_words);
+	dataset.n_observations_per_class
+		= (uint32_t*) calloc(n_classes, sizeof(uint32_t));
+	dataset.observations_per_class
+		= (word_t**) malloc(sizeof(word_t*) * n_classes * CHECK_LINES);
+
+	word_t* empty = (word_t*) malloc(sizeof(word_t) * n_words);
+	uint32_t* read = (uint32_t*) malloc(sizeof(uint32_t) * CHECK_LINES);
+
+	if (dataset.data == NULL || dataset.n_observations_per_class == NULL
+		|| dataset.observations_per_class == NULL || empty == NULL
+		|| read == NULL) {
+		fprintf(stderr, "Error allocating %u lines\n", CHECK_LINES);
+		free_dataset(&dataset);
+		free(empty);
+		free(read);
+		return 1;
+	}
+
+	for (uint32_t i = 0; i < n_words; i++) {
+		empty[i] = fill;
+	}
+	for (uint32_t i = 0; i <= CHECK_LINES; i++) {
+		memcpy(dataset.data + i * n_words, empty, sizeof(word_t) * n_words);
+	}
+
+	uint32_t empty_class = line_get_class(&layout, empty);
+
+	int n_errors = 0;
+
+	for (uint32_t i = 0; i < CHECK_LINES; i++) {
+		word_t* line = dataset.data + i * n_words;
+		uint32_t line_class = i % n_classes;
+
+		if (i % 2 == 0) {
+			line_set_class(&layout, line, line_class);
+		} else {
+			set_class_bits(line, line_class, n_attributes, n_words,
+						   dataset.n_bits_for_class);
+		}
+
+		if (line_get_class(&layout, line) != line_class
+			|| reference_class(line, n_attributes, dataset.n_bits_for_class)
+				!= line_class
+			|| get_class(line, n_attributes, n_words,
+						 dataset.n_bits_for_class)
+				!= line_class
+			|| !has_same_attributes(line, empty, n_attributes)) {
+			n_errors++;
+		}
+	}
+
+	if (memcmp(dataset.data + CHECK_LINES * n_words, empty,
+			   sizeof(word_t) * n_words)
+		!= 0) {
+		n_errors++;
+	}
+
+	get_classes(&layout, dataset.data, CHECK_LINES, read);
+
+	for (uint32_t i = 0; i < CHECK_LINES; i++) {
+		if (read[i] != i % n_classes) {
+			n_errors++;
+		}
+	}
+
+	// The layout was left unset by init_dataset
+	fill_class_arrays(&dataset);
+
+	for (uint32_t c = 0; c < n_classes; c++) {
+		uint32_t n_lines = dataset.n_observations_per_class[c];
+
+		uint32_t expected = CHECK_LINES / n_classes
+			+ (c < CHECK_LINES % n_classes);
+
+		if (n_lines != expected) {
+			n_errors++;
+		}
+
+		for (uint32_t i = 0; i < n_lines; i++) {
+			const word_t* line
+				= dataset.observations_per_class[c * CHECK_LINES + i];
+
+			if (line_get_class(&layout, line) != c) {
+				n_errors++;
+			}
+		}
+	}
+
+	for (uint32_t i = 0; i < CHECK_LINES; i++) {
+		word_t* line = dataset.data + i * n_words;
+
+		line_set_class(&layout, line, empty_class);
+
+		if (memcmp(line, empty, sizeof(word_t) * n_words) != 0) {
+			n_errors++;
+		}
+	}
+
+	if (n_errors > 0) {
+		fprintf(stderr,
+				"Class round trip failed: %u attributes, %u classes, fill "
+				"%016lx, %d errors\n",
+				n_attributes, n_classes, fill, n_errors);
+	}
+
+	free_dataset(&dataset);
+	free(empty);
+	free(read);
+
+	return n_errors > 0;
+}
+
+int main(void)
+{
+	int n_errors = 0;
+
+	for (size_t a = 0; a < sizeof(attributes) / sizeof(attributes[0]); a++) {
+		for (size_t c = 0; c < sizeof(classes) / sizeof(classes[0]); c++) {
+			for (size_t f = 0; f < sizeof(fills) / sizeof(fills[0]); f++) {
+				n_errors += check_round_trip(attributes[a], classes[c],
+											 fills[f]);
+			}
+		}
+	}
+
+	fprintf(stdout, "check-layout, %s kernel: %s\n", transpose64_kernel(),
+			n_errors == 0 ? "OK" : "FAILED");
+
+	return n_errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,188 @@
+/*
+ ============================================================================
+ Name        : check-random.c
+ Author      : Eduardo Ribeiro
+ Description : Checks the Philox kernels against the published known answers
+               and the vector kernels against the scalar one
+ ============================================================================
+ */
+
+#include "types/bernoulli_t.h"
+#include "types/rng_t.h"
+#include "types/word_t.h"
+#include "utils/random.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Longest fill checked, in draws
+ */
+#define CHECK_MAX_DRAWS 1100
+
+/**
+ * Philox4x32-10 known answer: counter and key give out
+ * Random123 kat_vectors
+ */
+typedef struct kat_t {
+	uint32_t counter[4];
+	uint32_t key[2];
+	uint32_t out[4];
+} kat_t;
+
+static const kat_t kats[] = {
+	{ { 0x00000000, 0x00000000, 0x00000000, 0x00000000 },
+	  { 0x00000000, 0x00000000 },
+	  { 0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8 } },
+	{ { 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff },
+	  { 0xffffffff, 0xffffffff },
+	  { 0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd } },
+	{ { 0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344 },
+	  { 0xa4093822, 0x299f31d0 },
+	  { 0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1 } },
+};
+
+/**
+ * Positions the fills start at: block boundaries and the middle of blocks
+ */
+static const uint64_t positions[] = { 0, 1, 2, 3, 5, 7, 15, 17, 63, 129, 1001 };
+
+/**
+ * Fill lengths: empty, shorter and longer than a vector of blocks
+ */
+static const uint64_t lengths[]
+	= { 0, 1, 2, 3, 7, 8, 9, 15, 16, 17, 31, 33, 64, 65, 1000, 1099 };
+
+/**
+ * Probabilities, in percent, for bernoulli_fill
+ */
+static const unsigned char probabilities[] = { 0, 1, 3, 26, 50, 77, 100 };
+
+static int check_kats(void)
+{
+	int n_errors = 0;
+
+	for (size_t k = 0; k < sizeof(kats) / sizeof(kats[0]); k++) {
+		uint32_t out[4];
+
+		philox4x32(kats[k].key, kats[k].counter, out);
+
+		if (memcmp(out, kats[k].out, sizeof(out)) != 0) {
+			fprintf(stderr, "philox4x32 known answer %zu: got %08x %08x %08x "
+							"%08x\n",
+					k, out[0], out[1], out[2], out[3]);
+			n_errors++;
+		}
+	}
+
+	return n_errors;
+}
+
+/**
+ * rng_fill against rng_fill_scalar and against rng_next, which never uses
+ * the vector kernels. The draw after the fill must match too
+ */
+static int check_fill(const uint64_t seed, const uint64_t stream)
+{
+	static uint64_t vector[CHECK_MAX_DRAWS];
+	static uint64_t scalar[CHECK_MAX_DRAWS];
+	static uint64_t single[CHECK_MAX_DRAWS];
+
+	int n_errors = 0;
+
+	for (size_t p = 0; p < sizeof(positions) / sizeof(positions[0]); p++) {
+		for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+			uint64_t n = lengths[l];
+			rng_t a, b, c;
+
+			rng_init(&a, seed, RNG_DOMAIN_ATTRIBUTES, stream);
+			rng_seek(&a, positions[p]);
+			b = a;
+			c = a;
+
+			rng_fill(&a, vector, n);
+			rng_fill_scalar(&b, scalar, n);
+			for (uint64_t i = 0; i < n; i++) {
+				single[i] = rng_next(&c);
+			}
+
+			uint64_t next = rng_next(&c);
+
+			if (memcmp(vector, scalar, sizeof(uint64_t) * n) != 0
+				|| memcmp(vector, single, sizeof(uint64_t) * n) != 0
+				|| rng_next(&a) != next || rng_next(&b) != next) {
+				fprintf(stderr,
+						"rng_fill differs: seed %lu, position %lu, %lu "
+						"draws\n",
+						seed, positions[p], n);
+				n_errors++;
+			}
+		}
+	}
+
+	return n_errors;
+}
+
+/**
+ * bernoulli_fill, which draws with rng_fill, against bernoulli_word, which
+ * draws with rng_next
+ */
+static int check_bernoulli(const uint64_t seed)
+{
+	static word_t vector[CHECK_MAX_DRAWS];
+	static word_t single[CHECK_MAX_DRAWS];
+
+	int n_errors = 0;
+
+	for (size_t q = 0; q < sizeof(probabilities) / sizeof(probabilities[0]);
+		 q++) {
+		bernoulli_t bernoulli;
+		bernoulli_init(&bernoulli, probabilities[q]);
+
+		for (size_t p = 0; p < sizeof(positions) / sizeof(positions[0]); p++) {
+			for (uint32_t n = 0; n < CHECK_MAX_DRAWS; n += 1 + n / 2) {
+				rng_t a, b;
+
+				rng_init(&a, seed, RNG_DOMAIN_ATTRIBUTES, positions[p]);
+				rng_seek(&a, positions[p]);
+				b = a;
+
+				bernoulli_fill(&bernoulli, &a, vector, n);
+				for (uint32_t i = 0; i < n; i++) {
+					single[i] = bernoulli_word(&bernoulli, &b);
+				}
+
+				if (memcmp(vector, single, sizeof(word_t) * n) != 0
+					|| a.position != b.position) {
+					fprintf(stderr,
+							"bernoulli_fill differs: %u%%, position %lu, %u "
+							"words\n",
+							probabilities[q], positions[p], n);
+					n_errors++;
+				}
+			}
+		}
+	}
+
+	return n_errors;
+}
+
+int main(void)
+{
+	static const uint64_t seeds[] = { 0, 1, 0x243f6a8885a308d3, UINT64_MAX };
+
+	int n_errors = check_kats();
+
+	for (size_t s = 0; s < sizeof(seeds) / sizeof(seeds[0]); s++) {
+		n_errors += check_fill(seeds[s], s);
+		n_errors += check_fill(seeds[s], UINT64_MAX - s);
+		n_errors += check_bernoulli(seeds[s]);
+	}
+
+	fprintf(stdout, "check-random, %s kernel: %s\n", rng_kernel(),
+			n_errors == 0 ? "OK" : "FAILED");
+
+	return n_errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
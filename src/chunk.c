@@ -0,0 +1,65 @@
+/*
+ ============================================================================
+ Name        : chunk.c
+ Author      : Eduardo Ribeiro
+ Description : Compresses dataset chunks outside the HDF5 filter pipeline
+ ============================================================================
+ */
+
+#include "chunk.h"
+
+#include "types/word_t.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <zlib.h>
+
+size_t chunk_compress_bound(const uint64_t chunk_words)
+{
+	return (size_t) compressBound((uLong) (chunk_words * sizeof(word_t)));
+}
+
+size_t chunk_compress(const word_t* block, const uint64_t n_lines,
+					  const uint32_t n_words, const uint64_t chunk_lines,
+					  const uint32_t first_word, const uint32_t chunk_words,
+					  const int level, word_t* scratch, uint8_t* out,
+					  const size_t out_size)
+{
+	uint64_t n_elements = chunk_lines * chunk_words;
+
+	word_t* chunk = scratch;
+	uint8_t* shuffled = (uint8_t*) (scratch + n_elements);
+
+	// Copy the chunk out of the block
+	uint32_t n_copy = chunk_words;
+	if (first_word + n_copy > n_words) {
+		n_copy = n_words - first_word;
+	}
+
+	memset(chunk, 0, sizeof(word_t) * n_elements);
+
+	for (uint64_t i = 0; i < chunk_lines && i < n_lines; i++) {
+		memcpy(chunk + i * chunk_words, block + i * n_words + first_word,
+			   sizeof(word_t) * n_copy);
+	}
+
+	// Byte j of every word goes to plane j
+	const uint8_t* bytes = (const uint8_t*) chunk;
+
+	for (uint64_t i = 0; i < n_elements; i++) {
+		for (size_t j = 0; j < sizeof(word_t); j++) {
+			shuffled[j * n_elements + i] = bytes[i * sizeof(word_t) + j];
+		}
+	}
+
+	uLongf compressed = (uLongf) out_size;
+
+	if (compress2(out, &compressed, shuffled,
+				  (uLong) (n_elements * sizeof(word_t)), level)
+		!= Z_OK) {
+		return 0;
+	}
+
+	return (size_t) compressed;
+}
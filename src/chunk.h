@@ -0,0 +1,36 @@
+/*
+ ============================================================================
+ Name        : chunk.h
+ Author      : Eduardo Ribeiro
+ Description : Compresses dataset chunks outside the HDF5 filter pipeline
+ ============================================================================
+ */
+
+#ifndef CHUNK_H
+#define CHUNK_H
+
+#include "types/word_t.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Largest compressed size of a chunk of chunk_words words
+ */
+size_t chunk_compress_bound(const uint64_t chunk_words);
+
+/**
+ * Compresses the chunk of chunk_lines x chunk_words words whose top left
+ * corner is word first_word of the first line of a block of n_lines x
+ * n_words words. Words outside the block are zero, as HDF5 pads edge chunks.
+ * The output matches the shuffle and deflate filters, in that order.
+ * scratch holds 2 * chunk_lines * chunk_words words.
+ * Returns the compressed size, or 0 if out is too small
+ */
+size_t chunk_compress(const word_t* block, const uint64_t n_lines,
+					  const uint32_t n_words, const uint64_t chunk_lines,
+					  const uint32_t first_word, const uint32_t chunk_words,
+					  const int level, word_t* scratch, uint8_t* out,
+					  const size_t out_size);
+
+#endif
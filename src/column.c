@@ -0,0 +1,240 @@
+/*
+ ============================================================================
+ Name        : column.c
+ Author      : Eduardo Ribeiro
+ Description : Builds the attribute-major copy of the dataset
+ ============================================================================
+ */
+
+#include "column.h"
+
+#include "dataset_hdf5.h"
+#include "types/dataset_hdf5_t.h"
+#include "types/dataset_t.h"
+#include "types/hdf5_layout_t.h"
+#include "types/oknok_t.h"
+#include "types/word_t.h"
+#include "utils/bit.h"
+
+#include "hdf5.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * Size of the tiles column_transpose works on, in 64 x 64 tiles: words of
+ * a line across and groups of 64 lines down
+ */
+#define COLUMN_TILE_WORDS 8
+#define COLUMN_TILE_GROUPS 8
+
+uint64_t column_words(const uint64_t n_lines)
+{
+	return (n_lines + WORD_BITS - 1) / WORD_BITS;
+}
+
+void column_transpose(const word_t* block, const uint64_t n_lines,
+					  const uint32_t n_words, const uint32_t n_attributes,
+					  word_t* columns)
+{
+	uint64_t n_groups = column_words(n_lines);
+
+	// Words with attributes, the class may take one more
+	uint32_t attribute_words = n_attributes / WORD_BITS
+		+ (n_attributes % WORD_BITS != 0);
+
+	// A tile of 64 x 64 tiles: COLUMN_TILE_GROUPS groups of 64 lines down,
+	// COLUMN_TILE_WORDS words across
+	uint64_t tiles[COLUMN_TILE_WORDS][COLUMN_TILE_GROUPS][WORD_BITS];
+
+	for (uint32_t w0 = 0; w0 < attribute_words; w0 += COLUMN_TILE_WORDS) {
+		uint32_t n_tile_words = attribute_words - w0;
+
+		if (n_tile_words > COLUMN_TILE_WORDS) {
+			n_tile_words = COLUMN_TILE_WORDS;
+		}
+
+		uint32_t first = w0 * WORD_BITS;
+		uint32_t n_rows = n_attributes - first;
+
+		if (n_rows > n_tile_words * WORD_BITS) {
+			n_rows = n_tile_words * WORD_BITS;
+		}
+
+		word_t* rows = columns + (uint64_t) first * n_groups;
+
+		// Tiles are filled left to right so the stores stream
+		for (uint64_t g0 = 0; g0 < n_groups; g0 += COLUMN_TILE_GROUPS) {
+			uint64_t n_tile_groups = n_groups - g0;
+
+			if (n_tile_groups > COLUMN_TILE_GROUPS) {
+				n_tile_groups = COLUMN_TILE_GROUPS;
+			}
+
+			const word_t* lines = block + g0 * WORD_BITS * n_words + w0;
+			uint64_t n_tile_lines = n_lines - g0 * WORD_BITS;
+
+			if (n_tile_lines > n_tile_groups * WORD_BITS) {
+				n_tile_lines = n_tile_groups * WORD_BITS;
+			}
+
+			// Consecutive words of a line go to the tiles side by side, so
+			// every cache line read is used whole
+			for (uint64_t r = 0; r < n_tile_lines; r++) {
+				for (uint32_t t = 0; t < n_tile_words; t++) {
+					tiles[t][r / WORD_BITS][r % WORD_BITS]
+						= lines[r * n_words + t];
+				}
+			}
+			for (uint64_t r = n_tile_lines; r < n_tile_groups * WORD_BITS;
+				 r++) {
+				for (uint32_t t = 0; t < n_tile_words; t++) {
+					tiles[t][r / WORD_BITS][r % WORD_BITS] = 0;
+				}
+			}
+
+			// Row c of tile t, g now holds attribute 64 (w0 + t) + c of
+			// group g0 + g
+			for (uint32_t t = 0; t < n_tile_words; t++) {
+				for (uint64_t g = 0; g < n_tile_groups; g++) {
+					transpose64(tiles[t][g]);
+				}
+			}
+
+			// Each row gets n_tile_groups consecutive words, up to a cache
+			// line
+			for (uint32_t c = 0; c < n_rows; c++) {
+				word_t* row = rows + c * n_groups + g0;
+
+				for (uint64_t g = 0; g < n_tile_groups; g++) {
+					row[g] = tiles[c / WORD_BITS][g][c % WORD_BITS];
+				}
+			}
+		}
+	}
+}
+
+hid_t column_create_dataset(const hid_t file_id, const dataset_t* dataset,
+							const bool no_fill)
+{
+	// Contiguous, so a column is read in one sweep
+	hdf5_layout_t layout = { .chunk_lines = 0,
+							 .chunk_words = 0,
+							 .chunk_cache_bytes = 0,
+							 .compress = false,
+							 .compression_level = 0,
+							 .no_fill = no_fill };
+
+	return hdf5_create_dataset(
+		file_id, DM_COLUMN_DATA, dataset->n_attributes,
+		(uint32_t) column_words(dataset->n_observations), H5T_NATIVE_UINT64,
+		&layout);
+}
+
+/**
+ * Writes the groups of 64 lines listed in groups, sorted and distinct, or
+ * every group when groups is NULL. Consecutive groups are transposed
+ * together, up to strip_lines lines
+ */
+static oknok_t column_write(const dataset_hdf5_t* hdf5_dataset,
+							const dataset_t* dataset, const hid_t column_id,
+							const uint64_t strip_lines, const uint64_t* groups,
+							const uint64_t n_groups)
+{
+	// Strips start on a tile
+	uint64_t strip_groups = column_words(strip_lines);
+	uint64_t n_strip_lines = strip_groups * WORD_BITS;
+
+	word_t* lines
+		= (word_t*) malloc(sizeof(word_t) * n_strip_lines * dataset->n_words);
+	word_t* columns = (word_t*) malloc(sizeof(word_t) * dataset->n_attributes
+									   * strip_groups);
+
+	oknok_t status = OK;
+
+	if (lines == NULL || columns == NULL) {
+		fprintf(stderr, "Error allocating a strip of %lu lines\n",
+				n_strip_lines);
+		status = NOK;
+	}
+
+	uint64_t i = 0;
+
+	while (status == OK && i < n_groups) {
+		uint64_t group = groups == NULL ? i : groups[i];
+		uint64_t n_run = 1;
+
+		while (n_run < strip_groups && i + n_run < n_groups
+			   && (groups == NULL || groups[i + n_run] == group + n_run)) {
+			n_run++;
+		}
+
+		uint64_t first = group * WORD_BITS;
+		uint64_t n_lines = dataset->n_observations - first;
+
+		if (n_lines > n_run * WORD_BITS) {
+			n_lines = n_run * WORD_BITS;
+		}
+
+		status = hdf5_read_lines(hdf5_dataset, (uint32_t) first,
+								 dataset->n_words, (uint32_t) n_lines, lines);
+
+		if (status == OK) {
+			column_transpose(lines, n_lines, dataset->n_words,
+							 dataset->n_attributes, columns);
+
+			hsize_t offset[2] = { 0, group };
+			hsize_t count[2] = { dataset->n_attributes, column_words(n_lines) };
+
+			status = hdf5_write_to_dataset(column_id, offset, count,
+										   H5T_NATIVE_UINT64, columns);
+		}
+
+		i += n_run;
+	}
+
+	free(columns);
+	free(lines);
+
+	return status;
+}
+
+oknok_t column_write_dataset(const dataset_hdf5_t* hdf5_dataset,
+							 const dataset_t* dataset, const hid_t column_id,
+							 const uint64_t strip_lines)
+{
+	return column_write(hdf5_dataset, dataset, column_id, strip_lines, NULL,
+						column_words(dataset->n_observations));
+}
+
+oknok_t column_write_lines(const dataset_hdf5_t* hdf5_dataset,
+						   const dataset_t* dataset, const hid_t column_id,
+						   const uint64_t strip_lines, const uint64_t* lines,
+						   const uint64_t n_lines)
+{
+	uint64_t* groups = (uint64_t*) malloc(sizeof(uint64_t) * (n_lines + 1));
+
+	if (groups == NULL) {
+		fprintf(stderr, "Error allocating %lu groups\n", n_lines);
+		return NOK;
+	}
+
+	uint64_t n_groups = 0;
+
+	for (uint64_t i = 0; i < n_lines; i++) {
+		uint64_t group = lines[i] / WORD_BITS;
+
+		if (n_groups == 0 || groups[n_groups - 1] != group) {
+			groups[n_groups++] = group;
+		}
+	}
+
+	oknok_t status = column_write(hdf5_dataset, dataset, column_id,
+								  strip_lines, groups, n_groups);
+
+	free(groups);
+
+	return status;
+}
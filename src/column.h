@@ -0,0 +1,62 @@
+/*
+ ============================================================================
+ Name        : column.h
+ Author      : Eduardo Ribeiro
+ Description : Builds the attribute-major copy of the dataset
+ ============================================================================
+ */
+
+#ifndef COLUMN_H
+#define COLUMN_H
+
+#include "types/dataset_hdf5_t.h"
+#include "types/dataset_t.h"
+#include "types/oknok_t.h"
+#include "types/word_t.h"
+
+#include "hdf5.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Number of words that hold one attribute of n_lines lines
+ */
+uint64_t column_words(const uint64_t n_lines);
+
+/**
+ * Transposes a block of n_lines lines of n_words words into attribute-major
+ * order: word g of attribute a holds attribute a of lines 64g to 64g + 63,
+ * first line in the most significant bit. The class bits are left out.
+ * columns holds n_attributes * column_words(n_lines) words
+ */
+void column_transpose(const word_t* block, const uint64_t n_lines,
+					  const uint32_t n_words, const uint32_t n_attributes,
+					  word_t* columns);
+
+/**
+ * Creates DM_COLUMN_DATA in file_id for the attributes of dataset
+ */
+hid_t column_create_dataset(const hid_t file_id, const dataset_t* dataset,
+							const bool no_fill);
+
+/**
+ * Writes the attribute-major copy of all lines of hdf5_dataset to
+ * column_id, strip_lines lines at a time. Memory stays at about twice the
+ * size of a strip
+ */
+oknok_t column_write_dataset(const dataset_hdf5_t* hdf5_dataset,
+							 const dataset_t* dataset, const hid_t column_id,
+							 const uint64_t strip_lines);
+
+/**
+ * Writes the attribute-major copy of the groups of 64 lines that hold the
+ * n_lines lines listed in lines, which must be sorted. The other groups are
+ * left as they are
+ */
+oknok_t column_write_lines(const dataset_hdf5_t* hdf5_dataset,
+						   const dataset_t* dataset, const hid_t column_id,
+						   const uint64_t strip_lines, const uint64_t* lines,
+						   const uint64_t n_lines);
+
+#endif
@@ -6,11 +6,22 @@
  ============================================================================
  */
 
+#include "column.h"
 #include "dataset.h"
 #include "dataset_hdf5.h"
+#include "generator.h"
+#include "injection.h"
+#include "metrics.h"
+#include "parallel.h"
+#include "types/hdf5_layout_t.h"
+#include "types/hdf5_line_writer_t.h"
+#include "types/metrics_t.h"
 #include "types/word_t.h"
+#include "utils/alias.h"
 #include "utils/bit.h"
+#include "utils/clock.h"
 #include "utils/clargs.h"
+#include "utils/random.h"
 
 #include "hdf5.h"
 
@@ -18,152 +29,923 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
+#include <sys/stat.h>
 
 /**
- *
+ * Opens the dataset of an existing file, with the chunk cache asked for.
+ * The cache is not stored in the file, so it is set on every open
  */
-int main(int argc, char** argv)
+static void open_existing(const clargs_t* args, dataset_hdf5_t* hdf5_dataset)
+{
+	size_t chunk_cache_bytes = (size_t) (args->chunk_cache_mb * 1024 * 1024);
+
+	if (args->in_memory) {
+		hdf5_open_dataset_in_memory(args->filename, args->datasetname,
+									chunk_cache_bytes, hdf5_dataset);
+	} else {
+		hdf5_open_dataset(args->filename, args->datasetname,
+						  chunk_cache_bytes, hdf5_dataset);
+	}
+
+	if (chunk_cache_bytes > 0
+		&& hdf5_get_chunk_lines(hdf5_dataset->dataset_id) == 0) {
+		fprintf(stderr,
+				"Warning: %s is not chunked, --chunk-cache-mb is ignored\n",
+				args->datasetname);
+	}
+}
+
+/**
+ * Checks that the shape and storage options agree with the dataset being
+ * appended to or resumed. Options left at 0 take the stored values
+ */
+static oknok_t check_existing(const clargs_t* args, const dataset_t* dataset,
+							  const hdf5_layout_t* stored)
 {
+	oknok_t status = OK;
+
+	if (args->n_attributes != dataset->n_attributes) {
+		fprintf(stderr, "%s has %u attributes, not %lu\n", args->datasetname,
+				dataset->n_attributes, args->n_attributes);
+		status = NOK;
+	}
+
+	if (args->n_classes != dataset->n_classes) {
+		fprintf(stderr, "%s has %u classes, not %lu\n", args->datasetname,
+				dataset->n_classes, args->n_classes);
+		status = NOK;
+	}
+
+	bool compress = (args->compress_dataset == USE_COMPRESSION);
+
+	if (compress != stored->compress
+		|| (compress && args->compression_level != stored->compression_level)) {
+		if (stored->compress) {
+			fprintf(stderr, "%s is compressed with -z %u\n",
+					args->datasetname, stored->compression_level);
+		} else {
+			fprintf(stderr, "%s is not compressed, -z does not apply\n",
+					args->datasetname);
+		}
+		status = NOK;
+	}
+
+	// Chunks wider than a line were made as wide as a line
+	uint64_t chunk_words = args->chunk_words;
+
+	if (chunk_words > dataset->n_words) {
+		chunk_words = dataset->n_words;
+	}
+
+	if ((args->chunk_lines > 0 && args->chunk_lines != stored->chunk_lines)
+		|| (chunk_words > 0 && chunk_words != stored->chunk_words)) {
+		if (stored->chunk_lines == 0) {
+			fprintf(stderr, "%s is not chunked\n", args->datasetname);
+		} else {
+			fprintf(stderr, "%s has chunks of %lu lines and %u words\n",
+					args->datasetname, stored->chunk_lines,
+					stored->chunk_words);
+		}
+		status = NOK;
+	}
+
+	return status;
+}
+
+/**
+ * Adds the inconsistencies and duplicates to the dataset in an existing file
+ */
+static int inject_dataset(const clargs_t* args)
+{
+	dataset_hdf5_t hdf5_dataset;
+
+	dataset_t dataset;
+
+	injection_plan_t injections;
+
+	metrics_t metrics;
+
+	if (!hdf5_file_has_dataset(args->filename, args->datasetname)) {
+		fprintf(stdout, "Dataset %s not found in %s\n", args->datasetname,
+				args->filename);
+		return EXIT_FAILURE;
+	}
+
+	open_existing(args, &hdf5_dataset);
+
+	init_dataset(&dataset);
+	if (hdf5_read_dataset_attributes(hdf5_dataset.dataset_id, &dataset)
+		!= OK) {
+		hdf5_close_dataset(&hdf5_dataset);
+		return EXIT_FAILURE;
+	}
+
+	bool has_columns
+		= H5Lexists(hdf5_dataset.file_id, DM_COLUMN_DATA, H5P_DEFAULT) > 0;
+
+	if (has_columns && !args->column_data) {
+		fprintf(stderr,
+				"Warning: %s is not updated, add --column-data to rebuild "
+				"it\n",
+				DM_COLUMN_DATA);
+	}
+
+	metrics_init(&metrics, "inject", 0, sizeof(word_t) * dataset.n_words, 1);
+
+	if (injection_plan(&injections, &dataset, 0, args->n_inconsistencies,
+					   args->n_duplicates, args->seed)
+		!= OK) {
+		hdf5_close_dataset(&hdf5_dataset);
+		return EXIT_FAILURE;
+	}
+
+	metrics.plan_ns = clock_ns() - metrics.start_ns;
+	metrics.n_lines = injections.n_targets;
+
+	fprintf(stdout,
+			" - Adding %lu inconsistencies and %lu duplicates on %lu "
+			"lines.\n",
+			args->n_inconsistencies, args->n_duplicates, injections.n_targets);
+
+	metrics_start(&metrics);
+
+	oknok_t status = injection_write(&injections, &dataset, &hdf5_dataset);
+
+	metrics.elapsed_ns = clock_ns() - metrics.start_ns;
+	metrics.inject_ns = metrics.elapsed_ns;
+	metrics.lines_done = injections.n_targets;
+
+	// Lines that changed, sorted like the targets
+	uint64_t* changed = NULL;
+
+	if (status == OK && args->column_data && has_columns) {
+		changed = (uint64_t*) malloc(sizeof(uint64_t)
+									 * (injections.n_targets + 1));
+
+		if (changed == NULL) {
+			fprintf(stderr, "Error allocating %lu lines\n",
+					injections.n_targets);
+			status = NOK;
+		}
+
+		for (uint64_t i = 0; status == OK && i < injections.n_targets; i++) {
+			changed[i] = injections.targets[i].to;
+		}
+	}
+
+	uint64_t n_changed = injections.n_targets;
+
+	injection_free(&injections);
+
+	// An existing copy only gets the groups of 64 lines that changed, a new
+	// one is built from every line
+	if (status == OK && args->column_data) {
+		uint64_t column_start = clock_ns();
+
+		hid_t column_id = has_columns
+			? H5Dopen2(hdf5_dataset.file_id, DM_COLUMN_DATA, H5P_DEFAULT)
+			: column_create_dataset(hdf5_dataset.file_id, &dataset, false);
+
+		uint64_t strip_lines
+			= generator_block_lines(dataset.n_words, dataset.n_observations,
+									args->block_lines, args->block_mb);
+
+		status = NOK;
+		if (column_id >= 0 && has_columns) {
+			status = column_write_lines(&hdf5_dataset, &dataset, column_id,
+										strip_lines, changed, n_changed);
+		} else if (column_id >= 0) {
+			status = column_write_dataset(&hdf5_dataset, &dataset, column_id,
+										  strip_lines);
+		}
+
+		if (column_id >= 0) {
+			H5Dclose(column_id);
+		}
+
+		metrics.transpose_ns = clock_ns() - column_start;
+
+		fprintf(stdout, " - Wrote %s in %.3f s.\n", DM_COLUMN_DATA,
+				(double) metrics.transpose_ns / 1e9);
+	}
+
+	free(changed);
+
+	uint64_t start = clock_ns();
+
+	hdf5_close_dataset(&hdf5_dataset);
+
+	metrics.close_ns = clock_ns() - start;
+
+	if (status != OK) {
+		return EXIT_FAILURE;
+	}
+
+	fprintf(stdout, " - Planned in %.3f s, changed the lines in %.3f s.\n",
+			(double) metrics.plan_ns / 1e9, (double) metrics.inject_ns / 1e9);
+
+	if (args->metrics_json != NULL
+		&& metrics_write_json(&metrics, &dataset, args->seed,
+							  args->metrics_json)
+			!= OK) {
+		return EXIT_FAILURE;
+	}
+
+	fprintf(stdout, "All done!\n");
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Generates lines resume_line to resume_line + n_new_lines and writes them,
+ * this process's share of the blocks. Frees what it allocates, also on
+ * errors
+ */
+static oknok_t write_blocks(const clargs_t* args, const dataset_t* dataset,
+							const dataset_hdf5_t* hdf5_dataset,
+							const sampler_t* sampler,
+							const injection_plan_t* injections,
+							const hdf5_layout_t* layout, const hid_t column_id,
+							const uint64_t resume_line,
+							const uint64_t n_new_lines,
+							const uint64_t block_lines, metrics_t* metrics)
+{
+	generator_t generator;
+
+	hdf5_line_writer_t writer;
 
 	/**
-	 * Command line arguments set by the user
+	 * Block being written
 	 */
-	clargs_t args;
+	word_t* buffer = NULL;
+
+	// Fill data
+	fprintf(stdout, " - Starting filling in dataset.\n");
+
+	uint32_t n_slots = (uint32_t) args->n_ring_slots;
+	if (n_slots == 0) {
+		n_slots = 2 * (uint32_t) args->n_threads;
+	}
+
+	fprintf(stdout, " - Using %u buffers of %lu lines.\n", n_slots,
+			block_lines);
+
+	// Each process generates and writes its own range of blocks
+	uint64_t first_line = 0;
+	uint64_t n_rank_lines = 0;
+
+	parallel_lines(n_new_lines, block_lines, &first_line, &n_rank_lines);
+	first_line += resume_line;
+	metrics->n_lines = n_rank_lines;
+
+	if (parallel_size() > 1) {
+		fprintf(stdout, " - Splitting lines between %d processes.\n",
+				parallel_size());
+	}
+
+	if (generator_init(&generator, dataset, sampler, injections,
+					   (uint32_t) args->n_threads, block_lines, n_slots)
+			!= OK
+		|| (args->direct_chunks
+			&& generator_compress_chunks(&generator, layout->chunk_lines,
+										 layout->chunk_words,
+										 (int) layout->compression_level)
+				!= OK)
+		|| (args->column_data && generator_transpose_columns(&generator) != OK)
+		|| generator_start(&generator, first_line, n_rank_lines) != OK) {
+		generator_free(&generator);
+		return NOK;
+	}
+
+	oknok_t status = hdf5_line_writer_open(&writer, hdf5_dataset->dataset_id,
+										   first_line, dataset->n_words,
+										   H5T_NATIVE_UINT64);
+
+	uint64_t line = 0;
+	uint64_t n_lines = 0;
+
+	/**
+	 * Time, bytes and number of writes that skip the line writer: the
+	 * per-line baseline and the column copy
+	 */
+	uint64_t direct_ns = 0;
+	uint64_t direct_bytes = 0;
+	uint64_t n_direct_writes = 0;
+
+	metrics_start(metrics);
+
+	// Processes write their blocks out of order, so only a single process
+	// can tell which lines are stored. A file in memory is lost whole if the
+	// run stops, so it only gets the final checkpoint
+	bool checkpoints = (parallel_size() == 1 && !args->in_memory);
+	uint64_t checkpoint_ns = (uint64_t) (args->checkpoint_s * 1e9);
+	uint64_t last_checkpoint = metrics->start_ns;
+
+	// This thread writes the blocks while the workers fill the next ones
+	while (status == OK
+		   && (buffer = generator_next_block(&generator, &line, &n_lines))
+			   != NULL) {
+		if (args->direct_chunks) {
+			// Workers already compressed the chunks
+			uint32_t index = 0;
+
+			for (uint64_t i = 0; status == OK && i < n_lines;
+				 i += layout->chunk_lines) {
+				for (uint32_t j = 0; status == OK && j < dataset->n_words;
+					 j += layout->chunk_words) {
+					size_t size = 0;
+					const uint8_t* chunk
+						= generator_chunk(&generator, index++, &size);
+
+					hsize_t offset[2] = { line + i, j };
+
+					if (size == 0) {
+						fprintf(stderr, "Error compressing chunk at line %lu\n",
+								line + i);
+						status = NOK;
+					} else {
+						status = hdf5_line_writer_write_chunk(&writer, offset,
+															  chunk, size);
+					}
+				}
+			}
+		} else if (args->write_mode == WRITE_LINES) {
+			// Baseline: one write per line, with new dataspaces every time
+			uint64_t lines_start = clock_ns();
+
+			for (uint64_t i = 0; status == OK && i < n_lines; i++) {
+				status = hdf5_write_n_lines(
+					hdf5_dataset->dataset_id, (uint32_t) (line + i), 1,
+					dataset->n_words, H5T_NATIVE_UINT64,
+					buffer + i * dataset->n_words);
+			}
+
+			direct_ns += clock_ns() - lines_start;
+			direct_bytes += sizeof(word_t) * n_lines * dataset->n_words;
+			n_direct_writes += n_lines;
+		} else if (args->write_mode == WRITE_LINES_WRITER) {
+			// One write per line through the writer's dataspaces
+			for (uint64_t i = 0; status == OK && i < n_lines; i++) {
+				status = hdf5_line_writer_append(
+					&writer, 1, buffer + i * dataset->n_words);
+			}
+		} else {
+			status = hdf5_line_writer_append(&writer, n_lines, buffer);
+		}
+
+		if (status == OK && column_id >= 0) {
+			uint64_t column_start = clock_ns();
+
+			hsize_t offset[2] = { 0, line / WORD_BITS };
+			hsize_t count[2]
+				= { dataset->n_attributes, column_words(n_lines) };
+
+			status = hdf5_write_to_dataset(column_id, offset, count,
+										   H5T_NATIVE_UINT64,
+										   generator_columns(&generator));
+
+			direct_ns += clock_ns() - column_start;
+			direct_bytes += sizeof(word_t) * count[0] * count[1];
+			n_direct_writes++;
+		}
+
+		generator_release_block(&generator);
+
+		if (status == OK && checkpoints
+			&& (clock_ns() - last_checkpoint >= checkpoint_ns
+				|| line + n_lines == dataset->n_observations)) {
+			status = hdf5_write_checkpoint(hdf5_dataset->dataset_id,
+										   line + n_lines, true);
+			last_checkpoint = clock_ns();
+		}
+
+		metrics->lines_done += n_lines;
+
+		// Reports go by the clock, not by the number of lines
+		if (metrics_due(metrics)) {
+			metrics->write_ns = writer.write_ns + direct_ns;
+			generator_read_metrics(&generator, metrics);
+			metrics_progress(metrics);
+		}
+	}
+
+	// Compressed chunks may still be in the cache. Closing a file in memory
+	// writes them with the image, flushing would write the image twice
+	if (status == OK && !args->in_memory) {
+		status = hdf5_line_writer_flush(&writer);
+	}
+
+	// Flushing is collective: every process marks the dataset as complete.
+	// A file in memory saves it with the image when it is closed
+	if (status == OK && !checkpoints) {
+		status = hdf5_write_checkpoint(hdf5_dataset->dataset_id,
+									   dataset->n_observations,
+									   !args->in_memory);
+	}
+
+	hdf5_line_writer_close(&writer);
+
+	metrics->elapsed_ns = clock_ns() - metrics->start_ns;
+	metrics->write_ns = writer.write_ns + direct_ns;
+	metrics->n_writes = writer.n_calls + n_direct_writes;
+	metrics->write_bytes = writer.n_bytes + direct_bytes;
+	generator_read_metrics(&generator, metrics);
+
+	generator_free(&generator);
 
+	return status;
+}
+
+/**
+ * Generates a new dataset. Each process writes its share of the blocks
+ */
+static int create_dataset(const clargs_t* args)
+{
 	dataset_hdf5_t hdf5_dataset;
 
 	dataset_t dataset;
 
 	/**
-	 * Buffer to store one line/chunk of data
+	 * How lines are drawn
 	 */
-	word_t* buffer = NULL;
+	sampler_t sampler;
 
-	struct timespec tick;
-	clock_gettime(CLOCK_MONOTONIC_RAW, &tick);
+	/**
+	 * Inconsistencies and duplicates, applied while generating
+	 */
+	injection_plan_t injections;
 
-	unsigned int seed = (unsigned int) tick.tv_nsec;
+	/**
+	 * Progress and timings of the run
+	 */
+	metrics_t metrics;
 
-	// Seed the random number generator
-	// TODO: we could read the seed from the command line?
-	srand(seed);
+	/**
+	 * Attribute-major copy of the data, or -1
+	 */
+	hid_t column_id = -1;
 
-	// https://stackoverflow.com/questions/7866754/why-does-rand-7-always-return-0
-	rand();
+	/**
+	 * First line of the run: 0, or the old size when appending
+	 */
+	uint64_t generation_start = 0;
 
 	/**
-	 * Parse command line arguments
+	 * First line still to generate: the checkpoint when resuming
 	 */
-	if (read_args(argc, argv, &args) == READ_CL_ARGS_NOK) {
+	uint64_t resume_line = 0;
+
+	uint64_t seed = args->seed;
+
+	/**
+	 * Chunks and filters of the dataset when appending or resuming
+	 */
+	hdf5_layout_t stored = { 0 };
+
+	// Parallel HDF5 only applies filters with collective writes, and every
+	// process writes its blocks on its own
+	if (parallel_size() > 1
+		&& (args->compress_dataset == USE_COMPRESSION || args->in_memory
+			|| args->append || args->resume)) {
+		fprintf(stderr, "Compression, --in-memory, --append and --resume are "
+						"not available with MPI\n");
+		return EXIT_FAILURE;
+	}
+
+	if (args->append || args->resume) {
+		if (!hdf5_file_has_dataset(args->filename, args->datasetname)) {
+			fprintf(stdout, "Dataset %s not found in %s\n", args->datasetname,
+					args->filename);
+			return EXIT_FAILURE;
+		}
+
+		open_existing(args, &hdf5_dataset);
+
+		init_dataset(&dataset);
+		hdf5_get_layout(hdf5_dataset.dataset_id, &stored);
+
+		if (hdf5_read_dataset_attributes(hdf5_dataset.dataset_id, &dataset)
+				!= OK
+			|| check_existing(args, &dataset, &stored) != OK) {
+			hdf5_close_dataset(&hdf5_dataset);
+			return EXIT_FAILURE;
+		}
+
+		// New lines continue the sequence of the existing ones
+		if (H5Aexists(hdf5_dataset.dataset_id, SEED_ATTR) > 0) {
+			hdf5_read_attribute(hdf5_dataset.dataset_id, SEED_ATTR,
+								H5T_NATIVE_UINT64, &seed);
+		}
+
+		if (args->resume) {
+			if (H5Aexists(hdf5_dataset.dataset_id, CHECKPOINT_ATTR) <= 0) {
+				fprintf(stderr, "%s has no checkpoint\n", args->filename);
+				hdf5_close_dataset(&hdf5_dataset);
+				return EXIT_FAILURE;
+			}
+
+			if (H5Aexists(hdf5_dataset.dataset_id, GENERATION_START_ATTR)
+				> 0) {
+				hdf5_read_attribute(hdf5_dataset.dataset_id,
+									GENERATION_START_ATTR, H5T_NATIVE_UINT64,
+									&generation_start);
+			}
+			hdf5_read_attribute(hdf5_dataset.dataset_id, CHECKPOINT_ATTR,
+								H5T_NATIVE_UINT64, &resume_line);
+
+			if (resume_line >= dataset.n_observations) {
+				fprintf(stdout, " - All %u lines are already stored.\n",
+						dataset.n_observations);
+				hdf5_close_dataset(&hdf5_dataset);
+				return EXIT_SUCCESS;
+			}
+
+			fprintf(stdout, " - Resuming at line %lu of %u.\n", resume_line,
+					dataset.n_observations);
+		} else {
+			if (hdf5_get_chunk_lines(hdf5_dataset.dataset_id) == 0) {
+				fprintf(stderr, "Only chunked datasets can grow\n");
+				hdf5_close_dataset(&hdf5_dataset);
+				return EXIT_FAILURE;
+			}
+
+			if (args->n_observations > UINT32_MAX - dataset.n_observations) {
+				fprintf(stderr,
+						"Can't append %lu lines to %u, the dataset would "
+						"have more than %u lines\n",
+						args->n_observations, dataset.n_observations,
+						UINT32_MAX);
+				hdf5_close_dataset(&hdf5_dataset);
+				return EXIT_FAILURE;
+			}
+
+			generation_start = dataset.n_observations;
+			resume_line = generation_start;
+			dataset.n_observations += (uint32_t) args->n_observations;
+
+			fprintf(stdout, " - Appending %lu lines to %lu.\n",
+					args->n_observations, generation_start);
+		}
+	} else {
+		dataset.n_classes = (uint32_t) args->n_classes;
+		dataset.n_attributes = (uint32_t) args->n_attributes;
+		dataset.n_observations = (uint32_t) args->n_observations;
+		dataset.n_bits_for_class = (uint8_t) ceil(log2(dataset.n_classes));
+		dataset.n_bits_for_jnsqs = 0;
+
+		uint32_t total_bits = dataset.n_attributes + dataset.n_bits_for_class;
+		dataset.n_words
+			= total_bits / WORD_BITS + (total_bits % WORD_BITS != 0);
+
+		line_layout_init(&dataset.layout, dataset.n_attributes,
+						 dataset.n_words, dataset.n_bits_for_class);
+	}
+
+	fprintf(stdout, " - Using seed %lu and the %s random kernel.\n", seed,
+			rng_kernel());
+
+	sampler.seed = seed;
+
+	bernoulli_init(&sampler.bernoulli, args->probability_attribute_set);
+	if (sampler.bernoulli.sparse) {
+		fprintf(stdout, " - Using sparse generation below %d%%.\n",
+				BERNOULLI_SPARSE_THRESHOLD);
+	}
+
+	// Classes are equally likely unless weights are given
+	double* class_weights = NULL;
+
+	if (args->class_weights != NULL) {
+		class_weights = (double*) malloc(sizeof(double) * dataset.n_classes);
+		if (class_weights == NULL
+			|| read_class_weights(args->class_weights, dataset.n_classes,
+								  class_weights)
+				!= READ_CL_ARGS_OK) {
+			free(class_weights);
+			if (args->append || args->resume) {
+				hdf5_close_dataset(&hdf5_dataset);
+			}
+			return EXIT_FAILURE;
+		}
+	}
+
+	oknok_t status
+		= alias_init(&sampler.classes, class_weights, dataset.n_classes);
+	free(class_weights);
+
+	if (status != OK) {
+		alias_free(&sampler.classes);
+		if (args->append || args->resume) {
+			hdf5_close_dataset(&hdf5_dataset);
+		}
 		return EXIT_FAILURE;
 	}
 
 	/**
-	 * Create the data file
+	 * Lines this run still has to generate
 	 */
-	hdf5_dataset.file_id
-		= H5Fcreate(args.filename, H5F_ACC_EXCL, H5P_DEFAULT, H5P_DEFAULT);
-	if (hdf5_dataset.file_id < 1) {
-		// Error creating file
-		fprintf(stdout, "Error creating %s\n", args.filename);
-		return EXIT_FAILURE;
+	uint64_t n_new_lines = dataset.n_observations - resume_line;
+
+	uint64_t block_lines = generator_block_lines(
+		dataset.n_words, n_new_lines, args->block_lines, args->block_mb);
+
+	hdf5_layout_t layout;
+	layout.chunk_lines = args->chunk_lines;
+	layout.chunk_words = (uint32_t) args->chunk_words;
+	layout.chunk_cache_bytes = (size_t) (args->chunk_cache_mb * 1024 * 1024);
+	layout.compress = (args->compress_dataset == USE_COMPRESSION);
+	layout.compression_level = args->compression_level;
+	layout.no_fill = args->io_profile;
+
+	if (args->append || args->resume) {
+		// The dataset already has its chunks and filters
+		layout.chunk_lines = stored.chunk_lines;
+		layout.chunk_words = stored.chunk_words;
+		layout.compress = false;
 	}
-	fprintf(stdout, " - Empty file created.\n");
 
-	// Store data
-	dataset.n_classes = args.n_classes;
-	dataset.n_attributes = args.n_attributes;
-	dataset.n_observations = args.n_observations;
-	dataset.n_bits_for_class = (uint8_t) ceil(log2(dataset.n_classes));
-	dataset.n_bits_for_jnsqs = 0;
+	// Filters need a chunked dataset
+	if (layout.chunk_lines == 0
+		&& (layout.chunk_words > 0 || layout.chunk_cache_bytes > 0
+			|| layout.compress)) {
+		layout.chunk_lines = block_lines;
+	}
 
-	uint32_t total_bits = dataset.n_attributes + dataset.n_bits_for_class;
-	uint32_t n_words = total_bits / WORD_BITS + (total_bits % WORD_BITS != 0);
+	if (layout.chunk_lines > 0) {
+		// Chunks can't be larger than the dataset
+		if (layout.chunk_lines > dataset.n_observations) {
+			layout.chunk_lines = dataset.n_observations;
+		}
+		if (layout.chunk_words == 0 || layout.chunk_words > dataset.n_words) {
+			layout.chunk_words = dataset.n_words;
+		}
 
-	dataset.n_words = n_words;
+		// Write whole chunks: blocks hold a whole number of chunks
+		block_lines = (block_lines + layout.chunk_lines - 1)
+			/ layout.chunk_lines * layout.chunk_lines;
+		if (block_lines > n_new_lines) {
+			block_lines = n_new_lines;
+		}
 
-	hdf5_dataset.dataset_id = hdf5_create_dataset(
-		hdf5_dataset.file_id, args.datasetname, dataset.n_observations,
-		dataset.n_words, H5T_NATIVE_UINT64);
-	hdf5_dataset.dimensions[0] = dataset.n_observations;
-	hdf5_dataset.dimensions[1] = dataset.n_words;
+		fprintf(stdout, " - Using chunks of %lu lines and %u words.\n",
+				layout.chunk_lines, layout.chunk_words);
+	}
 
-	// Set dataset properties
+	if (args->column_data) {
+		// Blocks are transposed in tiles of 64 lines, and still hold whole
+		// chunks
+		uint64_t step = layout.chunk_lines > 0 ? layout.chunk_lines : 1;
+		uint64_t unit = step;
 
-	hdf5_write_attribute(hdf5_dataset.dataset_id, "n_classes",
-						 H5T_NATIVE_UINT64, &args.n_classes);
-	hdf5_write_attribute(hdf5_dataset.dataset_id, "n_attributes",
-						 H5T_NATIVE_UINT64, &args.n_attributes);
-	hdf5_write_attribute(hdf5_dataset.dataset_id, "n_observations",
-						 H5T_NATIVE_UINT64, &args.n_observations);
+		while (unit % WORD_BITS != 0) {
+			unit += step;
+		}
 
-	// Fill data
+		block_lines = (block_lines + unit - 1) / unit * unit;
+		if (block_lines > n_new_lines) {
+			block_lines = n_new_lines;
+		}
 
-	fprintf(stdout, " - Starting filling in dataset.\n");
+		if (resume_line % WORD_BITS != 0) {
+			fprintf(stderr, "Can't resume the columns at line %lu\n",
+					resume_line);
+			alias_free(&sampler.classes);
+			hdf5_close_dataset(&hdf5_dataset);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (layout.compress) {
+		fprintf(stdout, " - Compressing with shuffle and deflate level %u%s.\n",
+				layout.compression_level,
+				args->direct_chunks ? " in the generator threads" : "");
+	}
+
+	if (args->append) {
+		uint64_t n_observations = dataset.n_observations;
+
+		if (hdf5_extend_dataset(&hdf5_dataset, args->n_observations) != OK
+			|| hdf5_write_attribute(hdf5_dataset.dataset_id,
+									N_OBSERVATIONS_ATTR, H5T_NATIVE_UINT64,
+									&n_observations)
+				!= OK
+			|| hdf5_write_attribute(hdf5_dataset.dataset_id,
+									GENERATION_START_ATTR, H5T_NATIVE_UINT64,
+									&generation_start)
+				!= OK
+			|| hdf5_write_checkpoint(hdf5_dataset.dataset_id,
+									 generation_start, !args->in_memory)
+				!= OK) {
+			alias_free(&sampler.classes);
+			hdf5_close_dataset(&hdf5_dataset);
+			return EXIT_FAILURE;
+		}
+	} else if (!args->resume) {
+		/**
+		 * Create the data file. File, dataset and attribute creation are
+		 * collective: all processes make the same calls
+		 */
+		hid_t fapl_id = parallel_file_access();
+
+		if (args->io_profile) {
+			hsize_t alignment = hdf5_set_io_profile(fapl_id, args->filename);
+			fprintf(stdout,
+					" - Using the I/O profile, aligned to %llu bytes.\n",
+					alignment);
+		}
 
-	// Alocate buffer
-	buffer = (unsigned long*) malloc(sizeof(unsigned long) * dataset.n_words);
+		if (args->in_memory) {
+			// Grow the image once to the expected size
+			size_t increment = (size_t) (args->n_observations
+										 * (args->n_attributes / 8 + 8))
+				+ CORE_INCREMENT;
 
-	for (unsigned long line = 0; line < args.n_observations; line++) {
+			hdf5_set_in_memory(fapl_id, increment);
+			fprintf(stdout, " - Building the file in memory.\n");
+		}
 
-		fill_buffer(&dataset, args.probability_attribute_set, buffer);
-		hdf5_write_n_lines(hdf5_dataset.dataset_id, line, 1, dataset.n_words,
-						   H5T_NATIVE_UINT64, buffer);
+		hdf5_dataset.file_id
+			= H5Fcreate(args->filename, H5F_ACC_EXCL, H5P_DEFAULT, fapl_id);
+		H5Pclose(fapl_id);
 
-		if (line % 100 == 0) {
-			fprintf(stdout, " - Writing [%lu/%lu]\n", line,
-					args.n_observations);
+		if (hdf5_dataset.file_id < 1) {
+			// Error creating file
+			fprintf(stdout, "Error creating %s\n", args->filename);
+			alias_free(&sampler.classes);
+			return EXIT_FAILURE;
 		}
+		fprintf(stdout, " - Empty file created.\n");
+
+		hdf5_dataset.dataset_id = hdf5_create_dataset(
+			hdf5_dataset.file_id, args->datasetname, dataset.n_observations,
+			dataset.n_words, H5T_NATIVE_UINT64, &layout);
+		hdf5_dataset.dimensions[0] = dataset.n_observations;
+		hdf5_dataset.dimensions[1] = dataset.n_words;
+
+		// Set dataset properties
+
+		hdf5_write_attribute(hdf5_dataset.dataset_id, "n_classes",
+							 H5T_NATIVE_UINT64, &args->n_classes);
+		hdf5_write_attribute(hdf5_dataset.dataset_id, "n_attributes",
+							 H5T_NATIVE_UINT64, &args->n_attributes);
+		hdf5_write_attribute(hdf5_dataset.dataset_id, "n_observations",
+							 H5T_NATIVE_UINT64, &args->n_observations);
+		hdf5_write_attribute(hdf5_dataset.dataset_id, SEED_ATTR,
+							 H5T_NATIVE_UINT64, &seed);
+		hdf5_write_attribute(hdf5_dataset.dataset_id, GENERATION_START_ATTR,
+							 H5T_NATIVE_UINT64, &generation_start);
+		hdf5_write_checkpoint(hdf5_dataset.dataset_id, 0, !args->in_memory);
 	}
 
-	// Add inconsistencies
-	for (unsigned long i = 0; i < args.n_inconsistencies; i++) {
-		// Pick a random line
-		unsigned long from = rand() % args.n_observations;
+	if (args->column_data) {
+		if (args->resume) {
+			column_id = H5Dopen2(hdf5_dataset.file_id, DM_COLUMN_DATA,
+								 H5P_DEFAULT);
+		} else {
+			column_id = column_create_dataset(hdf5_dataset.file_id, &dataset,
+											  layout.no_fill);
+		}
+
+		if (column_id < 0) {
+			fprintf(stderr, "Error opening %s\n", DM_COLUMN_DATA);
+			alias_free(&sampler.classes);
+			hdf5_close_dataset(&hdf5_dataset);
+			return EXIT_FAILURE;
+		}
 
-		hdf5_read_line(&hdf5_dataset, from, dataset.n_words, buffer);
+		fprintf(stdout, " - Writing the attributes as lines in %s.\n",
+				DM_COLUMN_DATA);
+	}
 
-		// Get line class
-		unsigned long line_class
-			= get_class(buffer, dataset.n_attributes, dataset.n_words,
-						dataset.n_bits_for_class);
+	const char* mode = "create";
+	if (args->resume) {
+		mode = "resume";
+	} else if (args->append) {
+		mode = "append";
+	}
 
-		// Change its class
-		unsigned long new_class = 0;
-		do {
-			new_class = rand() % dataset.n_classes;
-		} while (new_class == line_class);
+	metrics_init(&metrics, mode, n_new_lines, sizeof(word_t) * dataset.n_words,
+				 (uint32_t) args->n_threads);
 
-		set_class_bits(buffer, new_class, dataset.n_attributes, dataset.n_words,
-					   dataset.n_bits_for_class);
+	// Every line is written once, so plan the changes up front.
+	// Appended lines only get changes among themselves
+	status = injection_plan(&injections, &dataset, generation_start,
+							args->n_inconsistencies, args->n_duplicates, seed);
 
-		// Put it back somewhere else
-		unsigned long to = rand() % args.n_observations;
+	if (status == OK) {
+		metrics.plan_ns = clock_ns() - metrics.start_ns;
 
-		hdf5_write_n_lines(hdf5_dataset.dataset_id, to, 1, dataset.n_words,
-						   H5T_NATIVE_UINT64, buffer);
+		fprintf(stdout,
+				" - Planned %lu inconsistencies and %lu duplicates on %lu "
+				"lines.\n",
+				args->n_inconsistencies, args->n_duplicates,
+				injections.n_targets);
+
+		status = write_blocks(args, &dataset, &hdf5_dataset, &sampler,
+							  &injections, &layout, column_id, resume_line,
+							  n_new_lines, block_lines, &metrics);
+	}
+
+	if (column_id >= 0) {
+		H5Dclose(column_id);
+	}
+
+	injection_free(&injections);
+	alias_free(&sampler.classes);
+
+	if (status != OK && parallel_size() > 1) {
+		// The other processes would wait forever to close the file
+		fprintf(stderr, "Process %d failed, aborting.\n", parallel_rank());
+		parallel_abort();
 	}
 
-	// Add duplicates
-	for (unsigned long i = 0; i < args.n_duplicates; i++) {
-		// Pick a random line
-		unsigned long from = rand() % args.n_observations;
+	if (status == OK) {
+		metrics.stored_bytes = H5Dget_storage_size(hdf5_dataset.dataset_id);
 
-		hdf5_read_line(&hdf5_dataset, from, dataset.n_words, buffer);
+		// Each process only saw its own share of the blocks
+		metrics_reduce(&metrics);
 
-		// Put it back somewhere else
-		unsigned long to = rand() % args.n_observations;
+		metrics_print(&metrics);
 
-		hdf5_write_n_lines(hdf5_dataset.dataset_id, to, 1, dataset.n_words,
-						   H5T_NATIVE_UINT64, buffer);
+		double dataset_mb = (double) (sizeof(word_t) * dataset.n_words)
+			* (double) dataset.n_observations / (1024 * 1024);
+		double stored_mb = (double) metrics.stored_bytes / (1024 * 1024);
+
+		fprintf(stdout, " - Stored %.1f MB, compression ratio %.2f.\n",
+				stored_mb, stored_mb > 0 ? dataset_mb / stored_mb : 0.0);
 	}
 
-	free(buffer);
+	// In memory files are written to disk now
+	uint64_t start = clock_ns();
 
 	hdf5_close_dataset(&hdf5_dataset);
 
+	metrics.close_ns = clock_ns() - start;
+
+	if (status != OK) {
+		return EXIT_FAILURE;
+	}
+
+	if (args->in_memory) {
+		fprintf(stdout, " - Saved the file in %.3f s.\n",
+				(double) metrics.close_ns / 1e9);
+	}
+
+	struct stat info;
+	if (parallel_rank() == 0 && stat(args->filename, &info) == 0) {
+		metrics.file_bytes = (uint64_t) info.st_size;
+		fprintf(stdout, " - File size is %.1f MB.\n",
+				(double) info.st_size / (1024 * 1024));
+	}
+
+	if (parallel_rank() == 0 && args->metrics_json != NULL
+		&& metrics_write_json(&metrics, &dataset, seed, args->metrics_json)
+			!= OK) {
+		return EXIT_FAILURE;
+	}
+
 	fprintf(stdout, "All done!\n");
 
 	return EXIT_SUCCESS;
 }
+
+/**
+ *
+ */
+int main(int argc, char** argv)
+{
+
+	/**
+	 * Command line arguments set by the user
+	 */
+	clargs_t args;
+
+	parallel_init(&argc, &argv);
+
+	/**
+	 * Parse command line arguments
+	 */
+	if (read_args(argc, argv, &args) == READ_CL_ARGS_NOK) {
+		parallel_finalize();
+		return EXIT_FAILURE;
+	}
+
+	// Every process must draw the same lines
+	parallel_share(&args.seed);
+
+	int status = EXIT_SUCCESS;
+
+	if (args.inject_only) {
+		// Injections are not split between processes
+		if (parallel_rank() == 0) {
+			fprintf(stdout, " - Using seed %lu.\n", args.seed);
+			status = inject_dataset(&args);
+		}
+	} else {
+		status = create_dataset(&args);
+	}
+
+	parallel_finalize();
+
+	return status;
+}
@@ -9,10 +9,16 @@
 #include "dataset.h"
 
 #include "types/dataset_t.h"
+#include "types/line_layout_t.h"
 #include "types/oknok_t.h"
+#include "types/rng_t.h"
+#include "types/sampler_t.h"
 #include "types/word_t.h"
+#include "utils/alias.h"
 #include "utils/bit.h"
+#include "utils/random.h"
 
+#include <assert.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -29,79 +35,128 @@ void init_dataset(dataset_t* dataset)
 	dataset->n_classes = 0;
 	dataset->n_observations = 0;
 	dataset->n_words = 0;
+
+	dataset->layout = (line_layout_t) { 0 };
 }
 
-uint32_t get_class(const word_t* line, const uint32_t n_attributes,
-				   const uint32_t n_words, const uint8_t n_bits_for_class)
+/**
+ * Mask with the n_bits lowest bits set, n_bits <= 32
+ */
+static word_t low_bits_mask(const uint8_t n_bits)
+{
+	return (((word_t) 1) << n_bits) - 1;
+}
+
+void line_layout_init(line_layout_t* layout, const uint32_t n_attributes,
+					  const uint32_t n_words, const uint8_t n_bits_for_class)
 {
 	// How many attributes remain on last word with attributes
 	uint8_t remaining = n_attributes % WORD_BITS;
 
-	if (n_bits_for_class == 1 || (remaining + n_bits_for_class <= WORD_BITS)) {
-		// All class bits are on the same word
+	layout->n_words = n_words;
 
-		// Class starts here
-		uint8_t at = (uint8_t) (WORD_BITS - remaining - n_bits_for_class);
+	if (remaining + n_bits_for_class <= WORD_BITS) {
+		// All class bits are on the last word, right after the attributes
+		layout->high_word = n_words - 1;
+		layout->high_shift = n_bits_for_class == 0
+			? 0
+			: (uint8_t) (WORD_BITS - remaining - n_bits_for_class);
+		layout->high_mask = low_bits_mask(n_bits_for_class);
 
-		return (uint32_t) get_bits(line[n_words - 1], at, n_bits_for_class);
-	}
+		layout->low_bits = 0;
+		layout->low_shift = 0;
+		layout->low_mask = 0;
 
-	// Class bits are split between 2 words
+		return;
+	}
 
-	// Number of class bits on penultimate word
+	// Class bits are split between 2 words: the high ones end the
+	// penultimate word and the low ones start the last word
 	uint8_t n_bits_p = WORD_BITS - remaining;
-
-	// Number of class bits on last word
 	uint8_t n_bits_l = n_bits_for_class - n_bits_p;
 
-	// Class bits from penultimate word
-	uint32_t high_b = (uint32_t) get_bits(line[n_words - 2], 0, n_bits_p);
+	layout->high_word = n_words - 2;
+	layout->high_shift = 0;
+	layout->high_mask = low_bits_mask(n_bits_p);
 
-	// Class bits from last word
-	uint32_t low_b = (uint32_t) get_bits(line[n_words - 1],
-										 WORD_BITS - n_bits_l, n_bits_l);
+	layout->low_bits = n_bits_l;
+	layout->low_shift = (uint8_t) (WORD_BITS - n_bits_l);
+	layout->low_mask = low_bits_mask(n_bits_l);
+}
+
+/**
+ * Class of a line, without branches
+ */
+static inline uint32_t layout_class(const line_layout_t* layout,
+									const word_t* line)
+{
+	word_t high = (line[layout->high_word] >> layout->high_shift)
+		& layout->high_mask;
+	word_t low = (line[layout->n_words - 1] >> layout->low_shift)
+		& layout->low_mask;
 
-	// Merge bits
-	high_b <<= n_bits_l;
-	high_b |= low_b;
+	return (uint32_t) ((high << layout->low_bits) | low);
+}
 
-	// Return class
-	return high_b;
+uint32_t line_get_class(const line_layout_t* layout, const word_t* line)
+{
+	return layout_class(layout, line);
 }
 
-void set_class_bits(word_t* line, uint32_t line_class,
-					const uint32_t n_attributes, const uint32_t n_words,
-					const uint8_t n_bits_for_class)
+void line_set_class(const line_layout_t* layout, word_t* line,
+					const uint32_t line_class)
 {
-	// How many attributes remain on last word with attributes
-	uint8_t remaining = n_attributes % WORD_BITS;
+	// An unset layout would write every class as 0
+	assert(layout->n_words > 0);
 
-	// Number of class bits on current word
-	uint8_t n_bits = n_bits_for_class;
+	word_t* high = &line[layout->high_word];
+	word_t* low = &line[layout->n_words - 1];
 
-	if (remaining + n_bits_for_class > WORD_BITS) {
-		// We have class bits split between words
+	*high = (*high & ~(layout->high_mask << layout->high_shift))
+		| ((((word_t) line_class >> layout->low_bits) & layout->high_mask)
+		   << layout->high_shift);
 
-		// Number of class bits on penultimate word
-		n_bits = WORD_BITS - remaining;
+	// Nothing changes here when the class is not split
+	*low = (*low & ~(layout->low_mask << layout->low_shift))
+		| (((word_t) line_class & layout->low_mask) << layout->low_shift);
+}
 
-		line[n_words - 2] = set_bits(line[n_words - 2], line_class, 0, n_bits);
+void get_classes(const line_layout_t* layout, const word_t* lines,
+				 const uint64_t n_lines, uint32_t* classes)
+{
+	// An unset layout would read every class as 0
+	assert(layout->n_words > 0);
 
-		// There's no more attributes on last word
-		remaining = 0;
+	// Local copies, so the compiler keeps them in registers
+	const line_layout_t l = *layout;
+	const word_t* high = lines + l.high_word;
+	const word_t* low = lines + l.n_words - 1;
 
-		// Remove used bits from class
-		line_class >>= n_bits;
+	for (uint64_t i = 0; i < n_lines; i++) {
+		word_t h = (high[i * l.n_words] >> l.high_shift) & l.high_mask;
+		word_t w = (low[i * l.n_words] >> l.low_shift) & l.low_mask;
 
-		// Number of class bits that need to go on the last word
-		n_bits = n_bits_for_class - n_bits;
+		classes[i] = (uint32_t) ((h << l.low_bits) | w);
 	}
+}
+
+uint32_t get_class(const word_t* line, const uint32_t n_attributes,
+				   const uint32_t n_words, const uint8_t n_bits_for_class)
+{
+	line_layout_t layout;
+	line_layout_init(&layout, n_attributes, n_words, n_bits_for_class);
 
-	// All remaining class bits are in the same word
-	uint8_t class_start = WORD_BITS - remaining - n_bits;
+	return layout_class(&layout, line);
+}
 
-	line[n_words - 1]
-		= set_bits(line[n_words - 1], line_class, class_start, n_bits);
+void set_class_bits(word_t* line, uint32_t line_class,
+					const uint32_t n_attributes, const uint32_t n_words,
+					const uint8_t n_bits_for_class)
+{
+	line_layout_t layout;
+	line_layout_init(&layout, n_attributes, n_words, n_bits_for_class);
+
+	line_set_class(&layout, line, line_class);
 }
 
 int compare_lines_extra(const void* a, const void* b, void* n_words)
@@ -190,83 +245,71 @@ oknok_t fill_class_arrays(dataset_t* dataset)
 	// Number of longs in a line
 	uint32_t n_words = dataset->n_words;
 
-	// Number of attributes
-	uint32_t n_attributes = dataset->n_attributes;
-
 	// Number of observations
 	uint32_t n_obs = dataset->n_observations;
 
-	// Number of bits needed to store class
-	uint8_t n_bits_for_class = dataset->n_bits_for_class;
-
 	// Array that stores the number of observations for each class
 	uint32_t* n_class_obs = dataset->n_observations_per_class;
 
 	// Matrix that stores the list of observations per class
 	word_t** class_obs = dataset->observations_per_class;
 
+	// Classes of a batch of lines
+	uint32_t classes[CLASS_BATCH_LINES];
+
 	// Current line
 	word_t* line = dataset->data;
 
-	// This is the current index
-	for (uint32_t i = 0; i < n_obs; i++) {
-		uint32_t lc = get_class(line, n_attributes, n_words, n_bits_for_class);
+	// init_dataset leaves the layout unset
+	if (dataset->layout.n_words != n_words) {
+		line_layout_init(&dataset->layout, dataset->n_attributes, n_words,
+						 dataset->n_bits_for_class);
+	}
+
+	for (uint32_t first = 0; first < n_obs; first += CLASS_BATCH_LINES) {
+		uint32_t n_lines = n_obs - first;
 
-		class_obs[lc * n_obs + n_class_obs[lc]] = line;
+		if (n_lines > CLASS_BATCH_LINES) {
+			n_lines = CLASS_BATCH_LINES;
+		}
 
-		n_class_obs[lc]++;
+		get_classes(&dataset->layout, line, n_lines, classes);
 
-		NEXT_LINE(line, n_words);
+		for (uint32_t i = 0; i < n_lines; i++) {
+			uint32_t lc = classes[i];
+
+			class_obs[lc * n_obs + n_class_obs[lc]] = line;
+
+			n_class_obs[lc]++;
+
+			NEXT_LINE(line, n_words);
+		}
 	}
 
 	return OK;
 }
 
-void fill_buffer(dataset_t* dataset, unsigned char probability_attribute_set,
-				 word_t* buffer)
+void fill_buffer(const dataset_t* dataset, const sampler_t* sampler,
+				 const uint64_t line, word_t* buffer)
 {
-	/**
-	 * Probability of attribute being set to '1'
-	 */
-	unsigned int probability = ((float) RAND_MAX / 100.0F) * probability_attribute_set;
+	rng_t rng;
 
 	// What class will this line be?
-	unsigned int line_class = rand() % dataset->n_classes;
-
-	// How many words are fully filled with atributes
-	unsigned long n_full_words = dataset->n_attributes / WORD_BITS;
+	rng_init(&rng, sampler->seed, RNG_DOMAIN_CLASS, line);
+	uint32_t line_class = alias_sample(&sampler->classes, rng_next(&rng));
 
-	// How many bits remain on last word
-	unsigned long n_bits_on_last_word = dataset->n_attributes % WORD_BITS;
+	// Attribute bits come from their own stream
+	rng_init(&rng, sampler->seed, RNG_DOMAIN_ATTRIBUTES, line);
 
 	// Reset buffer
 	memset(buffer, 0, dataset->n_words * sizeof(word_t));
 
-	// Fill full words
-	for (unsigned long i = 0; i < n_full_words; i++) {
-		word_t mask = 1;
-		for (unsigned int bit = 0; bit < WORD_BITS; bit++) {
-			unsigned int r = rand();
-			if (r <= probability) {
-				buffer[i] |= mask;
-			}
-			mask <<= 1;
-		}
-	}
-
-	word_t mask = AND_MASK_TABLE[63];
-	// Fill remaining bits on last long
-	for (unsigned int bit = 0; bit < n_bits_on_last_word; bit++) {
-		unsigned int r = rand();
-		if (r < probability) {
-			buffer[n_full_words] |= mask;
-		}
-		mask >>= 1;
-	}
+	// Fill attributes
+	bernoulli_fill_bits(&sampler->bernoulli, &rng, buffer,
+						dataset->n_attributes);
 
 	// Fill class
-	set_class_bits(buffer, line_class, dataset->n_attributes, dataset->n_words,
-				   dataset->n_bits_for_class);
+	line_set_class(&dataset->layout, buffer, line_class);
 }
 
 void free_dataset(dataset_t* dataset)
@@ -10,7 +10,9 @@
 #define DATASET_H
 
 #include "types/dataset_t.h"
+#include "types/line_layout_t.h"
 #include "types/oknok_t.h"
+#include "types/sampler_t.h"
 #include "types/word_t.h"
 
 #include <stdbool.h>
@@ -23,6 +25,11 @@
 #define DATASET_NOT_ENOUGH_OBSERVATIONS 8
 #define DATASET_ERROR_ALLOCATING_DATA 16
 
+/**
+ * Lines whose classes fill_class_arrays extracts at a time
+ */
+#define CLASS_BATCH_LINES 1024
+
 #define NEXT_LINE(line, n_words) ((line) += (n_words))
 
 #define GET_NEXT_LINE(line, n_words) ((line) + (n_words))
@@ -35,12 +42,41 @@
  */
 void init_dataset(dataset_t* dataset);
 
+/**
+ * Works out where the class bits of a line are. Only depends on the shape of
+ * the dataset, so it is done once
+ */
+void line_layout_init(line_layout_t* layout, const uint32_t n_attributes,
+					  const uint32_t n_words, const uint8_t n_bits_for_class);
+
 /**
  * Returns the class of this data line
  */
+uint32_t line_get_class(const line_layout_t* layout, const word_t* line);
+
+/**
+ * Sets the class bits of this data line
+ */
+void line_set_class(const line_layout_t* layout, word_t* line,
+					const uint32_t line_class);
+
+/**
+ * Stores the classes of n_lines consecutive lines in classes
+ */
+void get_classes(const line_layout_t* layout, const word_t* lines,
+				 const uint64_t n_lines, uint32_t* classes);
+
+/**
+ * Returns the class of this data line.
+ * Works out the layout on every call, use line_get_class in loops
+ */
 uint32_t get_class(const word_t* line, const uint32_t n_attributes,
 				   const uint32_t n_words, const uint8_t n_bits_for_class);
 
+/**
+ * Sets the class bits of this data line.
+ * Works out the layout on every call, use line_set_class in loops
+ */
 void set_class_bits(word_t* line, uint32_t line_class,
 					const uint32_t n_attributes, const uint32_t n_words,
 					const uint8_t n_bits_for_class);
@@ -73,10 +109,12 @@ uint32_t remove_duplicates(dataset_t* dataset);
 oknok_t fill_class_arrays(dataset_t* dataset);
 
 /**
- * Fills the buffer with a random line of 0 and 1
+ * Fills the buffer with a random line of 0 and 1.
+ * The line only depends on seed and its index, so lines can be generated in
+ * any order
  */
-void fill_buffer(dataset_t* dataset, unsigned char probability_attribute_set,
-				 word_t* buffer);
+void fill_buffer(const dataset_t* dataset, const sampler_t* sampler,
+				 const uint64_t line, word_t* buffer);
 
 /**
  * Frees dataset memory
@@ -8,53 +8,273 @@
 
 #include "dataset_hdf5.h"
 
+#include "dataset.h"
 #include "types/dataset_t.h"
+#include "types/hdf5_layout_t.h"
+#include "types/hdf5_line_writer_t.h"
 #include "types/oknok_t.h"
 #include "types/word_t.h"
+#include "utils/clock.h"
 
 #include "hdf5.h"
 
 #include <assert.h>
+#include <libgen.h>
 #include <math.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+/**
+ * Smallest prime not below n
+ */
+static size_t next_prime(size_t n)
+{
+	for (;; n++) {
+		bool prime = n > 1;
+
+		for (size_t d = 2; prime && d * d <= n; d++) {
+			prime = (n % d != 0);
+		}
+
+		if (prime) {
+			return n;
+		}
+	}
+}
+
+/**
+ * Sets a chunk cache of cache_bytes bytes for chunks of chunk_bytes bytes
+ */
+static void hdf5_set_chunk_cache(const hid_t dapl_id, const size_t chunk_bytes,
+								 const size_t cache_bytes)
+{
+	size_t n_chunks = cache_bytes / chunk_bytes + 1;
+
+	// HDF5 suggests ~100 hash slots per cached chunk, prime.
+	// Chunks are written whole, so evict those first (w0 = 1)
+	herr_t err = H5Pset_chunk_cache(dapl_id, next_prime(100 * n_chunks),
+									cache_bytes, 1.0);
+	assert(err != NOK);
+}
+
+/**
+ * Opens a dataset. The chunk cache is not stored in the file, so a chunked
+ * dataset is opened again with a cache of chunk_cache_bytes bytes, when not
+ * 0
+ */
+static hid_t hdf5_open_cached(const hid_t file_id, const char* datasetname,
+							  const size_t chunk_cache_bytes)
+{
+	hid_t dset_id = H5Dopen(file_id, datasetname, H5P_DEFAULT);
+
+	if (dset_id < 0 || chunk_cache_bytes == 0) {
+		return dset_id;
+	}
+
+	hid_t dcpl_id = H5Dget_create_plist(dset_id);
+	hsize_t chunk[2] = { 0, 0 };
+	bool chunked = H5Pget_layout(dcpl_id) == H5D_CHUNKED
+		&& H5Pget_chunk(dcpl_id, 2, chunk) == 2;
+	H5Pclose(dcpl_id);
+
+	if (!chunked) {
+		return dset_id;
+	}
+
+	hid_t type_id = H5Dget_type(dset_id);
+	size_t chunk_bytes = (size_t) (chunk[0] * chunk[1]) * H5Tget_size(type_id);
+	H5Tclose(type_id);
+	H5Dclose(dset_id);
+
+	hid_t dapl_id = H5Pcreate(H5P_DATASET_ACCESS);
+	assert(dapl_id != NOK);
+
+	hdf5_set_chunk_cache(dapl_id, chunk_bytes, chunk_cache_bytes);
+
+	dset_id = H5Dopen(file_id, datasetname, dapl_id);
+	H5Pclose(dapl_id);
+
+	return dset_id;
+}
+
+/**
+ * Opens the file with the given access properties, and the dataset
+ */
+static oknok_t hdf5_open_dataset_with(const char* filename,
+									  const char* datasetname,
+									  const hid_t acc_tpl,
+									  const size_t chunk_cache_bytes,
+									  dataset_hdf5_t* dataset)
+{
+	// Open the file
+	hid_t f_id = H5Fopen(filename, H5F_ACC_RDWR, acc_tpl);
+	assert(f_id != NOK);
+
+	// Open the dataset
+	hid_t dset_id = hdf5_open_cached(f_id, datasetname, chunk_cache_bytes);
+	assert(dset_id != NOK);
+
+	dataset->file_id = f_id;
+	dataset->dataset_id = dset_id;
+	hdf5_get_dataset_dimensions(dset_id, dataset->dimensions);
+
+	return OK;
+}
 
 oknok_t hdf5_open_dataset(const char* filename, const char* datasetname,
+						  const size_t chunk_cache_bytes,
 						  dataset_hdf5_t* dataset)
 {
 	// Setup file access template
 	hid_t acc_tpl = H5Pcreate(H5P_FILE_ACCESS);
 	assert(acc_tpl != NOK);
 
-	// Open the file
-	hid_t f_id = H5Fopen(filename, H5F_ACC_RDWR, acc_tpl);
-	assert(f_id != NOK);
+	oknok_t status = hdf5_open_dataset_with(filename, datasetname, acc_tpl,
+											chunk_cache_bytes, dataset);
 
 	// Release file-access template
 	herr_t ret = H5Pclose(acc_tpl);
 	assert(ret != NOK);
 
-	// Open the dataset
-	hid_t dset_id = H5Dopen(f_id, datasetname, H5P_DEFAULT);
-	assert(dset_id != NOK);
+	return status;
+}
 
-	dataset->file_id = f_id;
-	dataset->dataset_id = dset_id;
-	hdf5_get_dataset_dimensions(dset_id, dataset->dimensions);
+oknok_t hdf5_open_dataset_in_memory(const char* filename,
+									const char* datasetname,
+									const size_t chunk_cache_bytes,
+									dataset_hdf5_t* dataset)
+{
+	hid_t acc_tpl = H5Pcreate(H5P_FILE_ACCESS);
+	assert(acc_tpl != NOK);
+
+	// The whole file is read now and written back on close
+	hdf5_set_in_memory(acc_tpl, CORE_INCREMENT);
+
+	oknok_t status = hdf5_open_dataset_with(filename, datasetname, acc_tpl,
+											chunk_cache_bytes, dataset);
+
+	herr_t ret = H5Pclose(acc_tpl);
+	assert(ret != NOK);
+
+	return status;
+}
+
+void hdf5_set_in_memory(const hid_t fapl_id, const size_t increment)
+{
+	herr_t ret = H5Pset_fapl_core(fapl_id, increment, true);
+	assert(ret != NOK);
+
+	// Otherwise each flush writes the whole image, even the unused part
+	ret = H5Pset_core_write_tracking(fapl_id, true, CORE_PAGE_SIZE);
+	assert(ret != NOK);
+}
+
+hsize_t hdf5_set_io_profile(const hid_t fapl_id, const char* filename)
+{
+	// Block size of the filesystem the file goes to
+	char* path = strdup(filename);
+	struct stat info;
+
+	hsize_t alignment = IO_PROFILE_ALIGNMENT;
+	if (path != NULL && stat(dirname(path), &info) == 0
+		&& info.st_blksize > 0) {
+		alignment = (hsize_t) info.st_blksize;
+	}
+	free(path);
+
+	// Objects of at least one block start on a block boundary
+	herr_t err = H5Pset_alignment(fapl_id, alignment, alignment);
+	assert(err != NOK);
+
+	err = H5Pset_meta_block_size(fapl_id, IO_PROFILE_META_BLOCK);
+	assert(err != NOK);
+
+	err = H5Pset_libver_bounds(fapl_id, H5F_LIBVER_LATEST, H5F_LIBVER_LATEST);
+	assert(err != NOK);
+
+	return alignment;
+}
+
+uint64_t hdf5_get_chunk_lines(const hid_t dataset_id)
+{
+	hid_t dcpl_id = H5Dget_create_plist(dataset_id);
+	hsize_t chunk[2] = { 0, 0 };
+
+	if (H5Pget_layout(dcpl_id) == H5D_CHUNKED) {
+		H5Pget_chunk(dcpl_id, 2, chunk);
+	}
+
+	H5Pclose(dcpl_id);
+
+	return chunk[0];
+}
+
+void hdf5_get_layout(const hid_t dataset_id, hdf5_layout_t* layout)
+{
+	hid_t dcpl_id = H5Dget_create_plist(dataset_id);
+	hsize_t chunk[2] = { 0, 0 };
+
+	*layout = (hdf5_layout_t) { 0 };
+
+	if (H5Pget_layout(dcpl_id) == H5D_CHUNKED) {
+		H5Pget_chunk(dcpl_id, 2, chunk);
+	}
+
+	layout->chunk_lines = chunk[0];
+	layout->chunk_words = (uint32_t) chunk[1];
+
+	int n_filters = H5Pget_nfilters(dcpl_id);
+
+	for (int i = 0; i < n_filters; i++) {
+		// Deflate keeps its level as the only parameter
+		unsigned int flags = 0;
+		size_t n_values = 1;
+		unsigned int level = 0;
+
+		if (H5Pget_filter2(dcpl_id, (unsigned int) i, &flags, &n_values,
+						   &level, 0, NULL, NULL)
+			== H5Z_FILTER_DEFLATE) {
+			layout->compress = true;
+			layout->compression_level = level;
+		}
+	}
+
+	H5Pclose(dcpl_id);
+}
+
+oknok_t hdf5_extend_dataset(dataset_hdf5_t* dataset, const uint64_t n_lines)
+{
+	hsize_t dimensions[2] = { dataset->dimensions[0] + n_lines,
+							  dataset->dimensions[1] };
+
+	if (H5Dset_extent(dataset->dataset_id, dimensions) < 0) {
+		fprintf(stderr, "Error extending the dataset to %llu lines\n",
+				dimensions[0]);
+		return NOK;
+	}
+
+	dataset->dimensions[0] = dimensions[0];
 
 	return OK;
 }
 
 hid_t hdf5_create_dataset(const hid_t file_id, const char* name,
 						  const uint32_t n_lines, const uint32_t n_words,
-						  const hid_t datatype)
+						  const hid_t datatype, const hdf5_layout_t* layout)
 {
 	// Dataset dimensions
 	hsize_t dimensions[2] = { n_lines, n_words };
 
-	hid_t filespace_id = H5Screate_simple(2, dimensions, NULL);
+	// Chunked datasets can grow
+	hsize_t max_dimensions[2] = { H5S_UNLIMITED, n_words };
+
+	hid_t filespace_id = H5Screate_simple(
+		2, dimensions, layout->chunk_lines > 0 ? max_dimensions : NULL);
 	assert(filespace_id != NOK);
 
 	// Create a dataset creation property list
@@ -65,6 +285,45 @@ hid_t hdf5_create_dataset(const hid_t file_id, const char* name,
 	hid_t dapl_id = H5Pcreate(H5P_DATASET_ACCESS);
 	assert(dapl_id != NOK);
 
+	if (layout->chunk_lines > 0) {
+		hsize_t chunk[2] = { layout->chunk_lines, layout->chunk_words };
+
+		if (chunk[1] == 0 || chunk[1] > n_words) {
+			chunk[1] = n_words;
+		}
+
+		herr_t err = H5Pset_chunk(dcpl_id, 2, chunk);
+		assert(err != NOK);
+
+		if (layout->chunk_cache_bytes > 0) {
+			hdf5_set_chunk_cache(
+				dapl_id, (size_t) (chunk[0] * chunk[1] * H5Tget_size(datatype)),
+				layout->chunk_cache_bytes);
+		}
+
+		if (layout->compress) {
+			// Grouping the bytes of each word first helps deflate on
+			// sparse lines
+			err = H5Pset_shuffle(dcpl_id);
+			assert(err != NOK);
+
+			err = H5Pset_deflate(dcpl_id, layout->compression_level);
+			assert(err != NOK);
+		}
+	}
+
+	if (layout->no_fill) {
+		// Every line is written, so fill values are never read.
+		// Compressed chunks are allocated when written, at their real size
+		if (!layout->compress) {
+			herr_t err = H5Pset_alloc_time(dcpl_id, H5D_ALLOC_TIME_EARLY);
+			assert(err != NOK);
+		}
+
+		herr_t err = H5Pset_fill_time(dcpl_id, H5D_FILL_TIME_NEVER);
+		assert(err != NOK);
+	}
+
 	// Create the dataset
 	hid_t dset_id = H5Dcreate(file_id, name, datatype, filespace_id,
 							  H5P_DEFAULT, dcpl_id, dapl_id);
@@ -143,6 +402,9 @@ oknok_t hdf5_read_dataset_attributes(hid_t dataset_id, dataset_t* dataset)
 
 	dataset->n_words = n_words;
 
+	line_layout_init(&dataset->layout, n_attributes, n_words,
+					 dataset->n_bits_for_class);
+
 	return OK;
 }
 
@@ -226,26 +488,184 @@ oknok_t hdf5_read_lines(const dataset_hdf5_t* dataset, const uint32_t index,
 	// Setup line dataspace
 	hid_t dataspace_id = H5Dget_space(dataset->dataset_id);
 
+	oknok_t status = OK;
+
 	// Select hyperslab on file dataset
-	H5Sselect_hyperslab(dataspace_id, H5S_SELECT_SET, offset, NULL, count,
-						NULL);
+	if (memspace_id < 0 || dataspace_id < 0
+		|| H5Sselect_hyperslab(dataspace_id, H5S_SELECT_SET, offset, NULL,
+							   count, NULL)
+			< 0) {
+		fprintf(stderr, "Error selecting %u lines at line %u\n", n_lines,
+				index);
+		status = NOK;
+	}
 
 	// Read line from dataset
-	H5Dread(dataset->dataset_id, H5T_NATIVE_UINT64, memspace_id, dataspace_id,
-			H5P_DEFAULT, lines);
+	if (status == OK
+		&& H5Dread(dataset->dataset_id, H5T_NATIVE_UINT64, memspace_id,
+				   dataspace_id, H5P_DEFAULT, lines)
+			< 0) {
+		fprintf(stderr, "Error reading %u lines at line %u\n", n_lines,
+				index);
+		status = NOK;
+	}
+
+	if (dataspace_id >= 0) {
+		H5Sclose(dataspace_id);
+	}
+	if (memspace_id >= 0) {
+		H5Sclose(memspace_id);
+	}
+
+	return status;
+}
+
+/**
+ * Lines selected one by one before halves are merged
+ */
+#define SELECT_LEAF_LINES 64
+
+/**
+ * Returns a copy of dataspace_id selecting the listed lines, which must be
+ * sorted and distinct. Runs of consecutive lines become one hyperslab.
+ * Adding hyperslabs one at a time to a selection is quadratic, so both
+ * halves are selected separately and then merged
+ */
+static hid_t hdf5_select_lines(const hid_t dataspace_id, const uint64_t* lines,
+							   const uint64_t n_lines, const uint32_t n_words)
+{
+	if (n_lines > SELECT_LEAF_LINES) {
+		uint64_t half = n_lines / 2;
+
+		hid_t low_id = hdf5_select_lines(dataspace_id, lines, half, n_words);
+		hid_t high_id = hdf5_select_lines(dataspace_id, lines + half,
+										  n_lines - half, n_words);
+
+		hid_t space_id = -1;
+		if (low_id >= 0 && high_id >= 0) {
+			space_id = H5Scombine_select(low_id, H5S_SELECT_OR, high_id);
+		}
+
+		if (low_id >= 0) {
+			H5Sclose(low_id);
+		}
+		if (high_id >= 0) {
+			H5Sclose(high_id);
+		}
+
+		return space_id;
+	}
+
+	hid_t space_id = H5Scopy(dataspace_id);
+	H5S_seloper_t op = H5S_SELECT_SET;
+
+	for (uint64_t i = 0; i < n_lines;) {
+		uint64_t run = 1;
+		while (i + run < n_lines && lines[i + run] == lines[i] + run) {
+			run++;
+		}
+
+		hsize_t offset[2] = { lines[i], 0 };
+		hsize_t count[2] = { run, n_words };
+
+		if (H5Sselect_hyperslab(space_id, op, offset, NULL, count, NULL) < 0) {
+			fprintf(stderr, "Error selecting line %lu\n", lines[i]);
+			H5Sclose(space_id);
+			return -1;
+		}
 
+		op = H5S_SELECT_OR;
+		i += run;
+	}
+
+	return space_id;
+}
+
+oknok_t hdf5_read_selected_lines(const dataset_hdf5_t* dataset,
+								 const uint64_t* lines, const uint64_t n_lines,
+								 const uint32_t n_words, word_t* buffer)
+{
+	if (n_lines == 0) {
+		return OK;
+	}
+
+	const hsize_t dimensions[2] = { n_lines, n_words };
+
+	hid_t dataspace_id = H5Dget_space(dataset->dataset_id);
+	hid_t selection_id
+		= hdf5_select_lines(dataspace_id, lines, n_lines, n_words);
 	H5Sclose(dataspace_id);
+
+	if (selection_id < 0) {
+		return NOK;
+	}
+
+	hid_t memspace_id = H5Screate_simple(2, dimensions, NULL);
+
+	// Selected lines are read in file order
+	oknok_t status = OK;
+	if (H5Dread(dataset->dataset_id, H5T_NATIVE_UINT64, memspace_id,
+				selection_id, H5P_DEFAULT, buffer)
+		< 0) {
+		fprintf(stderr, "Error reading %lu lines\n", n_lines);
+		status = NOK;
+	}
+
 	H5Sclose(memspace_id);
+	H5Sclose(selection_id);
 
-	return OK;
+	return status;
+}
+
+oknok_t hdf5_write_selected_lines(const hid_t dset_id, const uint64_t* lines,
+								  const uint64_t n_lines,
+								  const uint32_t n_words, const hid_t datatype,
+								  const void* buffer)
+{
+	if (n_lines == 0) {
+		return OK;
+	}
+
+	const hsize_t dimensions[2] = { n_lines, n_words };
+
+	hid_t filespace_id = H5Dget_space(dset_id);
+	hid_t selection_id
+		= hdf5_select_lines(filespace_id, lines, n_lines, n_words);
+	H5Sclose(filespace_id);
+
+	if (selection_id < 0) {
+		return NOK;
+	}
+
+	hid_t memspace_id = H5Screate_simple(2, dimensions, NULL);
+
+	oknok_t status = OK;
+	if (H5Dwrite(dset_id, datatype, memspace_id, selection_id, H5P_DEFAULT,
+				 buffer)
+		< 0) {
+		fprintf(stderr, "Error writing %lu lines\n", n_lines);
+		status = NOK;
+	}
+
+	H5Sclose(memspace_id);
+	H5Sclose(selection_id);
+
+	return status;
 }
 
 oknok_t hdf5_write_attribute(hid_t dataset_id, const char* attribute,
 							 hid_t datatype, const void* value)
 {
 	hid_t attr_dataspace = H5Screate(H5S_SCALAR);
-	hid_t attr = H5Acreate(dataset_id, attribute, datatype, attr_dataspace,
-						   H5P_DEFAULT, H5P_DEFAULT);
+	hid_t attr = -1;
+
+	// Existing attributes are overwritten
+	if (H5Aexists(dataset_id, attribute) > 0) {
+		attr = H5Aopen(dataset_id, attribute, H5P_DEFAULT);
+	} else {
+		attr = H5Acreate(dataset_id, attribute, datatype, attr_dataspace,
+						 H5P_DEFAULT, H5P_DEFAULT);
+	}
 	if (attr < 0) {
 		fprintf(stderr, "Error cretaing attribute %s.\n", attribute);
 		return NOK;
@@ -275,6 +695,23 @@ oknok_t hdf5_write_attribute(hid_t dataset_id, const char* attribute,
 	return OK;
 }
 
+oknok_t hdf5_write_checkpoint(hid_t dataset_id, uint64_t n_lines,
+							  const bool flush)
+{
+	// The lines must reach the file before the checkpoint that covers them
+	if ((flush && H5Fflush(dataset_id, H5F_SCOPE_LOCAL) < 0)
+		|| hdf5_write_attribute(dataset_id, CHECKPOINT_ATTR, H5T_NATIVE_UINT64,
+								&n_lines)
+			!= OK
+		|| (flush && H5Fflush(dataset_id, H5F_SCOPE_LOCAL) < 0)) {
+		fprintf(stderr, "Error saving the checkpoint at line %lu.\n",
+				n_lines);
+		return NOK;
+	}
+
+	return OK;
+}
+
 void hdf5_get_dataset_dimensions(hid_t dataset_id, hsize_t* dataset_dimensions)
 {
 	// Get filespace handle first.
@@ -366,3 +803,136 @@ oknok_t hdf5_write_to_dataset(const hid_t dset_id, const hsize_t offset[2],
 
 	return OK;
 }
+
+oknok_t hdf5_line_writer_open(hdf5_line_writer_t* writer,
+							  const hid_t dataset_id, const uint64_t first_line,
+							  const uint32_t n_words, const hid_t datatype)
+{
+	writer->dataset_id = dataset_id;
+	writer->datatype = datatype;
+	writer->n_words = n_words;
+	writer->memspace_lines = 1;
+	writer->next_line = first_line;
+
+	writer->n_bytes = 0;
+	writer->n_calls = 0;
+	writer->write_ns = 0;
+
+	const hsize_t dimensions[2] = { writer->memspace_lines, n_words };
+
+	writer->filespace_id = H5Dget_space(dataset_id);
+	writer->memspace_id = H5Screate_simple(2, dimensions, NULL);
+	writer->xfer_plist = H5Pcreate(H5P_DATASET_XFER);
+
+	if (writer->filespace_id < 0 || writer->memspace_id < 0
+		|| writer->xfer_plist < 0) {
+		fprintf(stderr, "Error preparing the dataset writer\n");
+		return NOK;
+	}
+
+	return OK;
+}
+
+oknok_t hdf5_line_writer_append(hdf5_line_writer_t* writer,
+								const uint64_t n_lines, const void* buffer)
+{
+	if (n_lines == 0) {
+		return OK;
+	}
+
+	hsize_t offset[2] = { writer->next_line, 0 };
+	hsize_t count[2] = { n_lines, writer->n_words };
+
+	// Full blocks keep the same buffer shape
+	if (n_lines != writer->memspace_lines) {
+		if (H5Sset_extent_simple(writer->memspace_id, 2, count, NULL) < 0) {
+			fprintf(stderr, "Error resizing the writer buffer\n");
+			return NOK;
+		}
+
+		writer->memspace_lines = n_lines;
+	}
+
+	if (H5Sselect_hyperslab(writer->filespace_id, H5S_SELECT_SET, offset, NULL,
+							count, NULL)
+		< 0) {
+		fprintf(stderr, "Error selecting line %lu\n", writer->next_line);
+		return NOK;
+	}
+
+	uint64_t start = clock_ns();
+
+	herr_t err
+		= H5Dwrite(writer->dataset_id, writer->datatype, writer->memspace_id,
+				   writer->filespace_id, writer->xfer_plist, buffer);
+
+	writer->write_ns += clock_ns() - start;
+	writer->n_calls++;
+
+	if (err < 0) {
+		fprintf(stderr, "Error writing line %lu\n", writer->next_line);
+		return NOK;
+	}
+
+	writer->n_bytes
+		+= n_lines * writer->n_words * H5Tget_size(writer->datatype);
+	writer->next_line += n_lines;
+
+	return OK;
+}
+
+oknok_t hdf5_line_writer_write_chunk(hdf5_line_writer_t* writer,
+									 const hsize_t offset[2],
+									 const void* chunk, const size_t size)
+{
+	uint64_t start = clock_ns();
+
+	// Filter mask 0: every filter was applied
+	herr_t err = H5Dwrite_chunk(writer->dataset_id, writer->xfer_plist, 0,
+								offset, size, chunk);
+
+	writer->write_ns += clock_ns() - start;
+	writer->n_calls++;
+
+	if (err < 0) {
+		fprintf(stderr, "Error writing chunk at line %llu\n", offset[0]);
+		return NOK;
+	}
+
+	writer->n_bytes += size;
+
+	return OK;
+}
+
+oknok_t hdf5_line_writer_flush(hdf5_line_writer_t* writer)
+{
+	uint64_t start = clock_ns();
+
+	herr_t err = H5Dflush(writer->dataset_id);
+
+	writer->write_ns += clock_ns() - start;
+
+	if (err < 0) {
+		fprintf(stderr, "Error flushing the dataset\n");
+		return NOK;
+	}
+
+	return OK;
+}
+
+void hdf5_line_writer_close(hdf5_line_writer_t* writer)
+{
+	if (writer->xfer_plist >= 0) {
+		H5Pclose(writer->xfer_plist);
+	}
+	if (writer->memspace_id >= 0) {
+		H5Sclose(writer->memspace_id);
+	}
+	if (writer->filespace_id >= 0) {
+		H5Sclose(writer->filespace_id);
+	}
+
+	writer->xfer_plist = -1;
+	writer->memspace_id = -1;
+	writer->filespace_id = -1;
+}
@@ -11,11 +11,14 @@
 
 #include "types/dataset_hdf5_t.h"
 #include "types/dataset_t.h"
+#include "types/hdf5_layout_t.h"
+#include "types/hdf5_line_writer_t.h"
 #include "types/oknok_t.h"
 
 #include "hdf5.h"
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 /**
@@ -55,23 +58,101 @@
  */
 #define N_OBSERVATIONS_ATTR "n_observations"
 
+/**
+ * Attribute for the seed used to generate the dataset
+ */
+#define SEED_ATTR "seed"
+
+/**
+ * Attribute for the first line the current run generates
+ */
+#define GENERATION_START_ATTR "generation_start"
+
+/**
+ * Attribute for the number of lines safely stored in the file
+ */
+#define CHECKPOINT_ATTR "checkpoint"
+
+/**
+ * Memory the core driver adds when an in-memory file grows
+ */
+#define CORE_INCREMENT (64 * 1024 * 1024)
+
+/**
+ * Pages the core driver tracks, so a flush only writes the changed ones
+ */
+#define CORE_PAGE_SIZE (1024 * 1024)
+
+/**
+ * Alignment when the filesystem block size is unknown
+ */
+#define IO_PROFILE_ALIGNMENT 4096
+
+/**
+ * Metadata block size of the I/O profile
+ */
+#define IO_PROFILE_META_BLOCK (64 * 1024)
+
 /**
  * Attrinute for the number of lines of the disjoint matrix
  */
 #define N_MATRIX_LINES_ATTR "n_matrix_lines"
 
 /**
- * Opens the file and dataset indicated
+ * Opens the file and dataset indicated. Chunked datasets get a chunk cache
+ * of chunk_cache_bytes bytes, 0 keeps the HDF5 default
  */
 oknok_t hdf5_open_dataset(const char* filename, const char* datasetname,
+						  const size_t chunk_cache_bytes,
 						  dataset_hdf5_t* dataset);
 
 /**
- * Creates a new dataset in the indicated file
+ * Opens the file and dataset indicated, with the whole file kept in memory
+ * until it is closed
+ */
+oknok_t hdf5_open_dataset_in_memory(const char* filename,
+									const char* datasetname,
+									const size_t chunk_cache_bytes,
+									dataset_hdf5_t* dataset);
+
+/**
+ * Builds the file in memory, growing it increment bytes at a time. It is
+ * written to filename when it is closed. Flushes only write the pages that
+ * changed, not the whole image
+ */
+void hdf5_set_in_memory(const hid_t fapl_id, const size_t increment);
+
+/**
+ * Tunes the access properties of a new file for large sequential writes:
+ * objects aligned to the filesystem block size of filename, larger
+ * metadata blocks and the latest file format.
+ * Returns the alignment
+ */
+hsize_t hdf5_set_io_profile(const hid_t fapl_id, const char* filename);
+
+/**
+ * Creates a new dataset in the indicated file, stored as described by layout.
+ * Chunked datasets have an unlimited number of lines
  */
 hid_t hdf5_create_dataset(const hid_t file_id, const char* name,
 						  const uint32_t n_lines, const uint32_t n_words,
-						  const hid_t datatype);
+						  const hid_t datatype, const hdf5_layout_t* layout);
+
+/**
+ * Returns the lines per chunk, or 0 if the dataset is not chunked
+ */
+uint64_t hdf5_get_chunk_lines(const hid_t dataset_id);
+
+/**
+ * Reads the chunks and the compression the dataset was created with.
+ * The chunk cache and no_fill are not stored, they are left at 0
+ */
+void hdf5_get_layout(const hid_t dataset_id, hdf5_layout_t* layout);
+
+/**
+ * Adds n_lines lines at the end of a chunked dataset
+ */
+oknok_t hdf5_extend_dataset(dataset_hdf5_t* dataset, const uint64_t n_lines);
 
 /**
  * Checks if dataset is present in file_id
@@ -111,12 +192,38 @@ oknok_t hdf5_read_line(const dataset_hdf5_t* dataset, const uint32_t index,
 oknok_t hdf5_read_lines(const dataset_hdf5_t* dataset, const uint32_t index,
 						const uint32_t n_words, const uint32_t n_lines,
 						word_t* lines);
+
 /**
- * Writes an attribute to the dataset
+ * Reads the listed lines with a single read. lines must be sorted and
+ * distinct; they are stored one after the other in buffer
+ */
+oknok_t hdf5_read_selected_lines(const dataset_hdf5_t* dataset,
+								 const uint64_t* lines, const uint64_t n_lines,
+								 const uint32_t n_words, word_t* buffer);
+
+/**
+ * Writes one buffer line to each of the listed lines with a single write.
+ * lines must be sorted and distinct
+ */
+oknok_t hdf5_write_selected_lines(const hid_t dset_id, const uint64_t* lines,
+								  const uint64_t n_lines,
+								  const uint32_t n_words, const hid_t datatype,
+								  const void* buffer);
+
+/**
+ * Writes an attribute to the dataset, replacing its value if it exists
  */
 oknok_t hdf5_write_attribute(hid_t dataset_id, const char* attribute,
 							 hid_t datatype, const void* value);
 
+/**
+ * Records that the first n_lines lines are stored. With flush the lines and
+ * the checkpoint reach the disk now. A file built in memory is written
+ * whole by each flush, so it only saves the checkpoint when it is closed
+ */
+oknok_t hdf5_write_checkpoint(hid_t dataset_id, uint64_t n_lines,
+							  const bool flush);
+
 /**
  * Returns the dataset dimensions stored in the hdf5 dataset
  */
@@ -134,6 +241,38 @@ oknok_t hdf5_write_n_lines(const hid_t dset_id, const uint32_t start,
 						   const uint32_t n_lines, const uint32_t n_words,
 						   const hid_t datatype, const void* buffer);
 
+/**
+ * Prepares to write lines of n_words words to the dataset, starting at
+ * first_line
+ */
+oknok_t hdf5_line_writer_open(hdf5_line_writer_t* writer,
+							  const hid_t dataset_id, const uint64_t first_line,
+							  const uint32_t n_words, const hid_t datatype);
+
+/**
+ * Writes n_lines lines after the last ones written
+ */
+oknok_t hdf5_line_writer_append(hdf5_line_writer_t* writer,
+								const uint64_t n_lines, const void* buffer);
+
+/**
+ * Stores a chunk that was already passed through the dataset filters.
+ * offset is the position of its first word
+ */
+oknok_t hdf5_line_writer_write_chunk(hdf5_line_writer_t* writer,
+									 const hsize_t offset[2],
+									 const void* chunk, const size_t size);
+
+/**
+ * Writes the dataset's cached data to the file
+ */
+oknok_t hdf5_line_writer_flush(hdf5_line_writer_t* writer);
+
+/**
+ * Frees the writer resources. The dataset stays open
+ */
+void hdf5_line_writer_close(hdf5_line_writer_t* writer);
+
 /**
  * Writes data to a dataset
  */
@@ -0,0 +1,463 @@
+/*
+ ============================================================================
+ Name        : generator.c
+ Author      : Eduardo Ribeiro
+ Description : Pool of workers that generate dataset lines in parallel
+ ============================================================================
+ */
+
+#include "generator.h"
+
+#include "chunk.h"
+#include "column.h"
+#include "dataset.h"
+#include "injection.h"
+#include "types/dataset_t.h"
+#include "types/generator_t.h"
+#include "types/injection_plan_t.h"
+#include "types/metrics_t.h"
+#include "types/oknok_t.h"
+#include "types/sampler_t.h"
+#include "types/word_t.h"
+#include "utils/clock.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * Slot is not holding a finished block
+ */
+#define SLOT_EMPTY UINT64_MAX
+
+/**
+ * Returns the number of lines in block
+ */
+static uint64_t generator_lines_in_block(const generator_t* generator,
+										 const uint64_t block)
+{
+	uint64_t first = block * generator->block_lines;
+	uint64_t n_lines = generator->n_lines - first;
+
+	return n_lines < generator->block_lines ? n_lines : generator->block_lines;
+}
+
+/**
+ * Attribute-major copy of the block in slot
+ */
+static word_t* generator_slot_columns(const generator_t* generator,
+									  const uint32_t slot)
+{
+	return generator->columns
+		+ (uint64_t) slot * generator->column_attributes
+		* column_words(generator->block_lines);
+}
+
+/**
+ * Words of scratch each worker gets: two chunks
+ */
+static size_t generator_scratch_words(const generator_t* generator)
+{
+	return 2 * (size_t) generator->chunk_lines * generator->chunk_words;
+}
+
+/**
+ * Compresses the chunks of a block into its slot
+ */
+static void generator_compress_block(generator_t* generator,
+									 const uint32_t slot,
+									 const word_t* block,
+									 const uint64_t n_lines, word_t* scratch)
+{
+	uint32_t n_words = generator->dataset->n_words;
+	uint32_t chunk_columns
+		= (n_words + generator->chunk_words - 1) / generator->chunk_words;
+
+	uint8_t* packed = generator->packed
+		+ (size_t) slot * generator->block_chunks * generator->chunk_bound;
+	size_t* packed_size
+		= generator->packed_size + (size_t) slot * generator->block_chunks;
+
+	uint32_t index = 0;
+
+	for (uint64_t line = 0; line < n_lines; line += generator->chunk_lines) {
+		for (uint32_t column = 0; column < chunk_columns; column++) {
+			packed_size[index] = chunk_compress(
+				block + line * n_words, n_lines - line, n_words,
+				generator->chunk_lines, column * generator->chunk_words,
+				generator->chunk_words, generator->compression_level,
+				scratch, packed + index * generator->chunk_bound,
+				generator->chunk_bound);
+
+			index++;
+		}
+	}
+}
+
+/**
+ * Worker loop: claims the next block, waits until its slot was written and
+ * fills it
+ */
+static void* generator_worker(void* arg)
+{
+	generator_t* generator = (generator_t*) arg;
+	const dataset_t* dataset = generator->dataset;
+
+	pthread_mutex_lock(&generator->lock);
+
+	// Chunks are built here before they are compressed
+	word_t* scratch = NULL;
+	if (generator->scratch != NULL) {
+		scratch = generator->scratch
+			+ generator->n_workers * generator_scratch_words(generator);
+	}
+	generator->n_workers++;
+
+	while (!generator->stop && generator->next_fill < generator->n_blocks) {
+		uint64_t block = generator->next_fill++;
+
+		// The slot is free once the block n_slots behind was written
+		if (block >= generator->next_write + generator->n_slots) {
+			uint64_t start = clock_ns();
+
+			while (!generator->stop
+				   && block >= generator->next_write + generator->n_slots) {
+				pthread_cond_wait(&generator->slot_free, &generator->lock);
+			}
+
+			generator->fill_stall_ns += clock_ns() - start;
+		}
+
+		if (generator->stop) {
+			break;
+		}
+
+		uint32_t slot = (uint32_t) (block % generator->n_slots);
+		uint64_t first_line
+			= generator->first_line + block * generator->block_lines;
+		uint64_t n_lines = generator_lines_in_block(generator, block);
+
+		pthread_mutex_unlock(&generator->lock);
+
+		word_t* block_start = generator->ring
+			+ (uint64_t) slot * generator->block_lines * dataset->n_words;
+		word_t* line = block_start;
+
+		uint64_t start = clock_ns();
+
+		for (uint64_t i = first_line; i < first_line + n_lines; i++) {
+			fill_buffer(dataset, generator->sampler, i, line);
+			NEXT_LINE(line, dataset->n_words);
+		}
+
+		uint64_t filled = clock_ns();
+
+		injection_apply(generator->injections, dataset, generator->sampler,
+						first_line, n_lines, block_start);
+
+		uint64_t injected = clock_ns();
+
+		if (generator->chunk_lines > 0) {
+			generator_compress_block(generator, slot, block_start, n_lines,
+									 scratch);
+		}
+
+		uint64_t compressed = clock_ns();
+
+		if (generator->columns != NULL) {
+			column_transpose(block_start, n_lines, dataset->n_words,
+							 generator->column_attributes,
+							 generator_slot_columns(generator, slot));
+		}
+
+		uint64_t transposed = clock_ns();
+
+		pthread_mutex_lock(&generator->lock);
+
+		generator->fill_ns += filled - start;
+		generator->inject_ns += injected - filled;
+		generator->compress_ns += compressed - injected;
+		generator->transpose_ns += transposed - compressed;
+
+		generator->slot_block[slot] = block;
+		if (block == generator->next_write) {
+			pthread_cond_signal(&generator->block_ready);
+		}
+	}
+
+	pthread_mutex_unlock(&generator->lock);
+
+	return NULL;
+}
+
+oknok_t generator_init(generator_t* generator, const dataset_t* dataset,
+					   const sampler_t* sampler,
+					   const injection_plan_t* injections,
+					   const uint32_t n_threads, const uint64_t block_lines,
+					   const uint32_t n_slots)
+{
+	generator->dataset = dataset;
+	generator->sampler = sampler;
+	generator->injections = injections;
+	generator->n_threads = n_threads;
+	generator->threads = NULL;
+	generator->n_running = 0;
+	generator->n_workers = 0;
+	generator->block_lines = block_lines;
+	generator->n_slots = n_slots;
+
+	generator->first_line = 0;
+	generator->n_lines = 0;
+	generator->n_blocks = 0;
+	generator->next_fill = 0;
+	generator->next_write = 0;
+	generator->stop = false;
+
+	generator->chunk_lines = 0;
+	generator->chunk_words = 0;
+	generator->compression_level = 0;
+	generator->block_chunks = 0;
+	generator->chunk_bound = 0;
+	generator->packed = NULL;
+	generator->packed_size = NULL;
+	generator->scratch = NULL;
+
+	generator->column_attributes = 0;
+	generator->columns = NULL;
+
+	generator->fill_ns = 0;
+	generator->inject_ns = 0;
+	generator->compress_ns = 0;
+	generator->transpose_ns = 0;
+	generator->fill_stall_ns = 0;
+	generator->write_stall_ns = 0;
+
+	pthread_mutex_init(&generator->lock, NULL);
+	pthread_cond_init(&generator->block_ready, NULL);
+	pthread_cond_init(&generator->slot_free, NULL);
+
+	generator->ring = (word_t*) malloc(sizeof(word_t) * dataset->n_words
+									   * block_lines * n_slots);
+	generator->slot_block = (uint64_t*) malloc(sizeof(uint64_t) * n_slots);
+	generator->threads = (pthread_t*) malloc(sizeof(pthread_t) * n_threads);
+
+	if (generator->ring == NULL || generator->slot_block == NULL
+		|| generator->threads == NULL) {
+		fprintf(stderr, "Error allocating %u blocks of %lu lines\n", n_slots,
+				block_lines);
+		return NOK;
+	}
+
+	for (uint32_t i = 0; i < n_slots; i++) {
+		generator->slot_block[i] = SLOT_EMPTY;
+	}
+
+	return OK;
+}
+
+oknok_t generator_compress_chunks(generator_t* generator,
+								  const uint64_t chunk_lines,
+								  const uint32_t chunk_words, const int level)
+{
+	uint32_t n_words = generator->dataset->n_words;
+
+	generator->chunk_lines = chunk_lines;
+	generator->chunk_words = chunk_words;
+	generator->compression_level = level;
+
+	generator->block_chunks
+		= (uint32_t) ((generator->block_lines + chunk_lines - 1) / chunk_lines)
+		* ((n_words + chunk_words - 1) / chunk_words);
+	generator->chunk_bound = chunk_compress_bound(chunk_lines * chunk_words);
+
+	size_t n_chunks = (size_t) generator->block_chunks * generator->n_slots;
+
+	generator->packed = (uint8_t*) malloc(n_chunks * generator->chunk_bound);
+	generator->packed_size = (size_t*) malloc(sizeof(size_t) * n_chunks);
+	generator->scratch = (word_t*) malloc(sizeof(word_t) * generator->n_threads
+										  * generator_scratch_words(generator));
+
+	if (generator->packed == NULL || generator->packed_size == NULL
+		|| generator->scratch == NULL) {
+		fprintf(stderr, "Error allocating %lu compressed chunks\n", n_chunks);
+		return NOK;
+	}
+
+	return OK;
+}
+
+oknok_t generator_transpose_columns(generator_t* generator)
+{
+	generator->column_attributes = generator->dataset->n_attributes;
+
+	size_t n_words = (size_t) generator->column_attributes
+		* column_words(generator->block_lines) * generator->n_slots;
+
+	generator->columns = (word_t*) malloc(sizeof(word_t) * n_words);
+
+	if (generator->columns == NULL) {
+		fprintf(stderr, "Error allocating %lu words for the columns\n",
+				n_words);
+		return NOK;
+	}
+
+	return OK;
+}
+
+oknok_t generator_start(generator_t* generator, const uint64_t first_line,
+						const uint64_t n_lines)
+{
+	generator->first_line = first_line;
+	generator->n_lines = n_lines;
+	generator->n_blocks
+		= (n_lines + generator->block_lines - 1) / generator->block_lines;
+
+	for (uint32_t i = 0; i < generator->n_threads; i++) {
+		if (pthread_create(&generator->threads[i], NULL, generator_worker,
+						   generator)
+			!= 0) {
+			fprintf(stderr, "Error creating generator thread %u\n", i);
+			return NOK;
+		}
+
+		generator->n_running++;
+	}
+
+	return OK;
+}
+
+word_t* generator_next_block(generator_t* generator, uint64_t* first_line,
+							 uint64_t* n_lines)
+{
+	uint64_t block = generator->next_write;
+
+	if (block >= generator->n_blocks) {
+		return NULL;
+	}
+
+	uint32_t slot = (uint32_t) (block % generator->n_slots);
+
+	pthread_mutex_lock(&generator->lock);
+
+	if (generator->slot_block[slot] != block) {
+		uint64_t start = clock_ns();
+
+		while (generator->slot_block[slot] != block) {
+			pthread_cond_wait(&generator->block_ready, &generator->lock);
+		}
+
+		generator->write_stall_ns += clock_ns() - start;
+	}
+
+	pthread_mutex_unlock(&generator->lock);
+
+	*first_line = generator->first_line + block * generator->block_lines;
+	*n_lines = generator_lines_in_block(generator, block);
+
+	return generator->ring
+		+ (uint64_t) slot * generator->block_lines
+		* generator->dataset->n_words;
+}
+
+const uint8_t* generator_chunk(const generator_t* generator,
+							   const uint32_t index, size_t* size)
+{
+	size_t chunk = (size_t) (generator->next_write % generator->n_slots)
+			* generator->block_chunks
+		+ index;
+
+	*size = generator->packed_size[chunk];
+
+	return generator->packed + chunk * generator->chunk_bound;
+}
+
+void generator_release_block(generator_t* generator)
+{
+	pthread_mutex_lock(&generator->lock);
+
+	uint32_t slot = (uint32_t) (generator->next_write % generator->n_slots);
+	generator->slot_block[slot] = SLOT_EMPTY;
+	generator->next_write++;
+
+	pthread_cond_broadcast(&generator->slot_free);
+
+	pthread_mutex_unlock(&generator->lock);
+}
+
+const word_t* generator_columns(const generator_t* generator)
+{
+	return generator_slot_columns(
+		generator, (uint32_t) (generator->next_write % generator->n_slots));
+}
+
+void generator_read_metrics(generator_t* generator, metrics_t* metrics)
+{
+	pthread_mutex_lock(&generator->lock);
+
+	metrics->fill_ns = generator->fill_ns;
+	metrics->inject_ns = generator->inject_ns;
+	metrics->compress_ns = generator->compress_ns;
+	metrics->transpose_ns = generator->transpose_ns;
+	metrics->fill_stall_ns = generator->fill_stall_ns;
+	metrics->write_stall_ns = generator->write_stall_ns;
+
+	pthread_mutex_unlock(&generator->lock);
+}
+
+uint64_t generator_block_lines(const uint32_t n_words,
+							   const uint64_t n_observations,
+							   const uint64_t block_lines,
+							   const double block_mb)
+{
+	uint64_t n_lines = block_lines;
+
+	if (n_lines == 0) {
+		n_lines = (uint64_t) (block_mb * 1024 * 1024
+							  / (double) (sizeof(word_t) * n_words));
+	}
+
+	if (n_lines == 0) {
+		n_lines = 1;
+	}
+
+	if (n_lines > n_observations) {
+		n_lines = n_observations;
+	}
+
+	return n_lines;
+}
+
+void generator_free(generator_t* generator)
+{
+	pthread_mutex_lock(&generator->lock);
+	generator->stop = true;
+	pthread_cond_broadcast(&generator->slot_free);
+	pthread_mutex_unlock(&generator->lock);
+
+	for (uint32_t i = 0; i < generator->n_running; i++) {
+		pthread_join(generator->threads[i], NULL);
+	}
+
+	free(generator->threads);
+	free(generator->packed_size);
+	free(generator->packed);
+	free(generator->scratch);
+	free(generator->columns);
+	free(generator->slot_block);
+	free(generator->ring);
+
+	generator->threads = NULL;
+	generator->packed_size = NULL;
+	generator->packed = NULL;
+	generator->scratch = NULL;
+	generator->columns = NULL;
+	generator->slot_block = NULL;
+	generator->ring = NULL;
+
+	pthread_cond_destroy(&generator->slot_free);
+	pthread_cond_destroy(&generator->block_ready);
+	pthread_mutex_destroy(&generator->lock);
+}
@@ -0,0 +1,101 @@
+/*
+ ============================================================================
+ Name        : generator.h
+ Author      : Eduardo Ribeiro
+ Description : Pool of workers that generate dataset lines in parallel
+ ============================================================================
+ */
+
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include "types/dataset_t.h"
+#include "types/generator_t.h"
+#include "types/injection_plan_t.h"
+#include "types/metrics_t.h"
+#include "types/oknok_t.h"
+#include "types/sampler_t.h"
+#include "types/word_t.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Allocates a ring of n_slots blocks of block_lines lines.
+ * The planned injections are applied to each block before it is handed out
+ */
+oknok_t generator_init(generator_t* generator, const dataset_t* dataset,
+					   const sampler_t* sampler,
+					   const injection_plan_t* injections,
+					   const uint32_t n_threads, const uint64_t block_lines,
+					   const uint32_t n_slots);
+
+/**
+ * Makes the workers also compress each block into chunks of chunk_lines x
+ * chunk_words words, shuffled and deflated at level.
+ * Blocks must hold a whole number of chunk lines
+ */
+oknok_t generator_compress_chunks(generator_t* generator,
+								  const uint64_t chunk_lines,
+								  const uint32_t chunk_words, const int level);
+
+/**
+ * Makes the workers also transpose each block into attribute-major order.
+ * Blocks must hold a multiple of 64 lines
+ */
+oknok_t generator_transpose_columns(generator_t* generator);
+
+/**
+ * Starts n_threads workers generating lines
+ * [first_line, first_line + n_lines). Each worker claims the next block,
+ * waits for its slot to be free and fills it
+ */
+oknok_t generator_start(generator_t* generator, const uint64_t first_line,
+						const uint64_t n_lines);
+
+/**
+ * Waits for the next block, in line order.
+ * Returns NULL when all blocks were handed out
+ */
+word_t* generator_next_block(generator_t* generator, uint64_t* first_line,
+							 uint64_t* n_lines);
+
+/**
+ * Returns compressed chunk index of the last block handed out and stores its
+ * size. Chunks are numbered by chunk line and then by chunk column.
+ * size is 0 if the chunk could not be compressed
+ */
+const uint8_t* generator_chunk(const generator_t* generator,
+							   const uint32_t index, size_t* size);
+
+/**
+ * Returns the last block handed out to the ring, once it is written
+ */
+void generator_release_block(generator_t* generator);
+
+/**
+ * Attribute-major copy of the block returned by generator_next_block
+ */
+const word_t* generator_columns(const generator_t* generator);
+
+/**
+ * Copies the time spent by the workers and the writer so far
+ */
+void generator_read_metrics(generator_t* generator, metrics_t* metrics);
+
+/**
+ * Returns the number of lines per block.
+ * block_lines wins if set, otherwise the block holds block_mb MB.
+ * The result is between 1 and n_observations
+ */
+uint64_t generator_block_lines(const uint32_t n_words,
+							   const uint64_t n_observations,
+							   const uint64_t block_lines,
+							   const double block_mb);
+
+/**
+ * Stops the workers and frees resources
+ */
+void generator_free(generator_t* generator);
+
+#endif
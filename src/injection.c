@@ -0,0 +1,340 @@
+/*
+ ============================================================================
+ Name        : injection.c
+ Author      : Eduardo Ribeiro
+ Description : Plans the inconsistencies and duplicates added to a dataset
+ ============================================================================
+ */
+
+#include "injection.h"
+
+#include "dataset.h"
+#include "dataset_hdf5.h"
+#include "types/dataset_hdf5_t.h"
+#include "types/dataset_t.h"
+#include "types/injection_plan_t.h"
+#include "types/injection_t.h"
+#include "types/oknok_t.h"
+#include "types/rng_t.h"
+#include "types/sampler_t.h"
+#include "types/word_t.h"
+#include "utils/random.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Injection index and the line it writes
+ */
+typedef struct write_t {
+	uint64_t to;
+	uint64_t index;
+} write_t;
+
+/**
+ * Orders writes by line and then by injection order
+ */
+static int compare_writes(const void* a, const void* b)
+{
+	const write_t* wa = (const write_t*) a;
+	const write_t* wb = (const write_t*) b;
+
+	if (wa->to != wb->to) {
+		return wa->to < wb->to ? -1 : 1;
+	}
+
+	if (wa->index != wb->index) {
+		return wa->index < wb->index ? -1 : 1;
+	}
+
+	return 0;
+}
+
+/**
+ * Orders line indexes
+ */
+static int compare_lines_index(const void* a, const void* b)
+{
+	uint64_t la = *(const uint64_t*) a;
+	uint64_t lb = *(const uint64_t*) b;
+
+	return (la > lb) - (la < lb);
+}
+
+/**
+ * Moves the line class class_shift classes ahead
+ */
+static void shift_class(const dataset_t* dataset, const uint32_t class_shift,
+						word_t* line)
+{
+	if (class_shift == 0) {
+		return;
+	}
+
+	uint32_t line_class = line_get_class(&dataset->layout, line);
+
+	line_set_class(&dataset->layout, line,
+				   (line_class + class_shift) % dataset->n_classes);
+}
+
+/**
+ * Number of writes that come before (to, index)
+ */
+static uint64_t count_writes_before(const write_t* writes,
+									const uint64_t n_writes, const uint64_t to,
+									const uint64_t index)
+{
+	write_t key = { to, index };
+	uint64_t low = 0;
+	uint64_t high = n_writes;
+
+	while (low < high) {
+		uint64_t mid = low + (high - low) / 2;
+
+		if (compare_writes(&writes[mid], &key) < 0) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	return low;
+}
+
+oknok_t injection_plan(injection_plan_t* plan, const dataset_t* dataset,
+					   const uint64_t first_line,
+					   const uint64_t n_inconsistencies,
+					   const uint64_t n_duplicates, const uint64_t seed)
+{
+	uint64_t n_lines = dataset->n_observations - first_line;
+
+	uint64_t n_injections = n_inconsistencies + n_duplicates;
+
+	plan->targets = NULL;
+	plan->n_targets = 0;
+
+	if (n_injections == 0) {
+		return OK;
+	}
+
+	injection_t* injections
+		= (injection_t*) malloc(sizeof(injection_t) * n_injections);
+	write_t* writes = (write_t*) malloc(sizeof(write_t) * n_injections);
+
+	if (injections == NULL || writes == NULL) {
+		fprintf(stderr, "Error allocating %lu injections\n", n_injections);
+		free(injections);
+		free(writes);
+		return NOK;
+	}
+
+	rng_t rng;
+	rng_init(&rng, seed, RNG_DOMAIN_INJECTIONS, first_line);
+
+	for (uint64_t i = 0; i < n_injections; i++) {
+		injection_t* injection = &injections[i];
+
+		// Pick a random line
+		injection->from = first_line + rng_bounded(rng_next(&rng), n_lines);
+
+		// Inconsistencies move the line to any of the other classes
+		injection->class_shift = 0;
+		if (i < n_inconsistencies) {
+			injection->class_shift = 1
+				+ (uint32_t) rng_bounded(rng_next(&rng),
+										 dataset->n_classes - 1);
+		}
+
+		// Put it back somewhere else
+		injection->to = first_line + rng_bounded(rng_next(&rng), n_lines);
+
+		writes[i].to = injection->to;
+		writes[i].index = i;
+	}
+
+	qsort(writes, n_injections, sizeof(write_t), compare_writes);
+
+	// Point each injection back to a generated line: if an earlier injection
+	// wrote the line it copies, copy what that one copied instead
+	for (uint64_t i = 0; i < n_injections; i++) {
+		injection_t* injection = &injections[i];
+
+		uint64_t before = count_writes_before(writes, n_injections,
+											  injection->from, i);
+
+		if (before > 0 && writes[before - 1].to == injection->from) {
+			const injection_t* source = &injections[writes[before - 1].index];
+
+			injection->from = source->from;
+			injection->class_shift = (uint32_t) ((injection->class_shift
+												  + source->class_shift)
+												 % dataset->n_classes);
+		}
+	}
+
+	uint64_t n_targets = 0;
+	for (uint64_t i = 0; i < n_injections; i++) {
+		n_targets
+			+= (i + 1 == n_injections || writes[i + 1].to != writes[i].to);
+	}
+
+	plan->targets = (injection_t*) malloc(sizeof(injection_t) * n_targets);
+	if (plan->targets == NULL) {
+		fprintf(stderr, "Error allocating %lu injections\n", n_targets);
+		free(injections);
+		free(writes);
+		return NOK;
+	}
+
+	// Keep the last injection that writes each line
+	for (uint64_t i = 0; i < n_injections; i++) {
+		if (i + 1 == n_injections || writes[i + 1].to != writes[i].to) {
+			plan->targets[plan->n_targets++] = injections[writes[i].index];
+		}
+	}
+
+	free(injections);
+	free(writes);
+
+	return OK;
+}
+
+void injection_apply(const injection_plan_t* plan, const dataset_t* dataset,
+					 const sampler_t* sampler, const uint64_t first_line,
+					 const uint64_t n_lines, word_t* lines)
+{
+	// First target in this range
+	uint64_t low = 0;
+	uint64_t high = plan->n_targets;
+
+	while (low < high) {
+		uint64_t mid = low + (high - low) / 2;
+
+		if (plan->targets[mid].to < first_line) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	for (uint64_t i = low;
+		 i < plan->n_targets && plan->targets[i].to < first_line + n_lines;
+		 i++) {
+		const injection_t* target = &plan->targets[i];
+
+		word_t* line = lines + (target->to - first_line) * dataset->n_words;
+
+		fill_buffer(dataset, sampler, target->from, line);
+		shift_class(dataset, target->class_shift, line);
+	}
+}
+
+oknok_t injection_write(const injection_plan_t* plan, const dataset_t* dataset,
+						const dataset_hdf5_t* hdf5_dataset)
+{
+	uint64_t n_targets = plan->n_targets;
+	uint32_t n_words = dataset->n_words;
+
+	if (n_targets == 0) {
+		return OK;
+	}
+
+	uint64_t* sources = (uint64_t*) malloc(sizeof(uint64_t) * n_targets);
+	uint64_t* targets = (uint64_t*) malloc(sizeof(uint64_t) * n_targets);
+	word_t* source_lines
+		= (word_t*) malloc(sizeof(word_t) * n_words * n_targets);
+	word_t* target_lines
+		= (word_t*) malloc(sizeof(word_t) * n_words * n_targets);
+
+	if (sources == NULL || targets == NULL || source_lines == NULL
+		|| target_lines == NULL) {
+		fprintf(stderr, "Error allocating %lu lines\n", n_targets);
+		free(target_lines);
+		free(source_lines);
+		free(targets);
+		free(sources);
+		return NOK;
+	}
+
+	// Distinct copied lines, in file order
+	uint64_t n_sources = 0;
+
+	for (uint64_t i = 0; i < n_targets; i++) {
+		sources[i] = plan->targets[i].from;
+		targets[i] = plan->targets[i].to;
+	}
+
+	qsort(sources, n_targets, sizeof(uint64_t), compare_lines_index);
+
+	for (uint64_t i = 0; i < n_targets; i++) {
+		if (n_sources == 0 || sources[i] != sources[n_sources - 1]) {
+			sources[n_sources++] = sources[i];
+		}
+	}
+
+	// Every source is read before any target is written, so sources hold
+	// the generated lines even when they are also targets
+	oknok_t status = hdf5_read_selected_lines(hdf5_dataset, sources,
+											  n_sources, n_words, source_lines);
+
+	// Targets are sorted by line, so chunks are visited in order
+	for (uint64_t i = 0; status == OK && i < n_targets; i++) {
+		const injection_t* target = &plan->targets[i];
+
+		const uint64_t* source
+			= (const uint64_t*) bsearch(&target->from, sources, n_sources,
+										sizeof(uint64_t), compare_lines_index);
+
+		memcpy(target_lines + i * n_words,
+			   source_lines + (uint64_t) (source - sources) * n_words,
+			   sizeof(word_t) * n_words);
+	}
+
+	// Classes of all the copies at once, then the inconsistencies move theirs
+	uint32_t classes[CLASS_BATCH_LINES];
+
+	for (uint64_t first = 0; status == OK && first < n_targets;
+		 first += CLASS_BATCH_LINES) {
+		uint64_t n_lines = n_targets - first;
+
+		if (n_lines > CLASS_BATCH_LINES) {
+			n_lines = CLASS_BATCH_LINES;
+		}
+
+		get_classes(&dataset->layout, target_lines + first * n_words, n_lines,
+					classes);
+
+		for (uint64_t i = 0; i < n_lines; i++) {
+			uint32_t class_shift = plan->targets[first + i].class_shift;
+
+			if (class_shift != 0) {
+				line_set_class(&dataset->layout,
+							   target_lines + (first + i) * n_words,
+							   (classes[i] + class_shift) % dataset->n_classes);
+			}
+		}
+	}
+
+	if (status == OK) {
+		status = hdf5_write_selected_lines(hdf5_dataset->dataset_id, targets,
+										   n_targets, n_words,
+										   H5T_NATIVE_UINT64, target_lines);
+	}
+
+	free(target_lines);
+	free(source_lines);
+	free(targets);
+	free(sources);
+
+	return status;
+}
+
+void injection_free(injection_plan_t* plan)
+{
+	free(plan->targets);
+
+	plan->targets = NULL;
+	plan->n_targets = 0;
+}
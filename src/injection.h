@@ -0,0 +1,54 @@
+/*
+ ============================================================================
+ Name        : injection.h
+ Author      : Eduardo Ribeiro
+ Description : Plans the inconsistencies and duplicates added to a dataset
+ ============================================================================
+ */
+
+#ifndef INJECTION_H
+#define INJECTION_H
+
+#include "types/dataset_hdf5_t.h"
+#include "types/dataset_t.h"
+#include "types/injection_plan_t.h"
+#include "types/oknok_t.h"
+#include "types/sampler_t.h"
+#include "types/word_t.h"
+
+#include <stdint.h>
+
+/**
+ * Draws all inconsistencies and then all duplicates between lines
+ * [first_line, n_observations) from the injection stream of seed, and
+ * resolves them into the final content of every line they overwrite.
+ * An injection may copy a line that an earlier one already overwrote, so
+ * each target points back to the generated line it is a copy of
+ */
+oknok_t injection_plan(injection_plan_t* plan, const dataset_t* dataset,
+					   const uint64_t first_line,
+					   const uint64_t n_inconsistencies,
+					   const uint64_t n_duplicates, const uint64_t seed);
+
+/**
+ * Overwrites the planned lines in [first_line, first_line + n_lines).
+ * lines holds that range, already generated
+ */
+void injection_apply(const injection_plan_t* plan, const dataset_t* dataset,
+					 const sampler_t* sampler, const uint64_t first_line,
+					 const uint64_t n_lines, word_t* lines);
+
+/**
+ * Applies the plan to an existing dataset: all the lines that are copied
+ * are read with one read, and all the overwritten lines are written with
+ * one write, in line order
+ */
+oknok_t injection_write(const injection_plan_t* plan, const dataset_t* dataset,
+						const dataset_hdf5_t* hdf5_dataset);
+
+/**
+ * Frees the plan
+ */
+void injection_free(injection_plan_t* plan);
+
+#endif
@@ -0,0 +1,205 @@
+/*
+ ============================================================================
+ Name        : metrics.c
+ Author      : Eduardo Ribeiro
+ Description : Reports the progress and timings of a run
+ ============================================================================
+ */
+
+#include "metrics.h"
+
+#include "parallel.h"
+#include "types/dataset_t.h"
+#include "types/metrics_t.h"
+#include "types/oknok_t.h"
+#include "utils/clock.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * Nanoseconds as seconds
+ */
+static double seconds(const uint64_t ns)
+{
+	return (double) ns / 1e9;
+}
+
+void metrics_init(metrics_t* metrics, const char* mode, const uint64_t n_lines,
+				  const uint64_t line_bytes, const uint32_t n_threads)
+{
+	metrics->mode = mode;
+	metrics->n_lines = n_lines;
+	metrics->line_bytes = line_bytes;
+	metrics->lines_done = 0;
+	metrics->n_threads = n_threads;
+
+	metrics->start_ns = clock_ns();
+	metrics->last_report_ns = metrics->start_ns;
+	metrics->report_ns = (uint64_t) METRICS_REPORT_S * 1000000000;
+
+	metrics->plan_ns = 0;
+	metrics->fill_ns = 0;
+	metrics->inject_ns = 0;
+	metrics->compress_ns = 0;
+	metrics->transpose_ns = 0;
+	metrics->write_ns = 0;
+	metrics->n_writes = 0;
+	metrics->write_bytes = 0;
+	metrics->fill_stall_ns = 0;
+	metrics->write_stall_ns = 0;
+	metrics->elapsed_ns = 0;
+	metrics->close_ns = 0;
+	metrics->stored_bytes = 0;
+	metrics->file_bytes = 0;
+}
+
+void metrics_start(metrics_t* metrics)
+{
+	metrics->start_ns = clock_ns();
+	metrics->last_report_ns = metrics->start_ns;
+}
+
+bool metrics_due(metrics_t* metrics)
+{
+	uint64_t now = clock_ns();
+
+	if (now - metrics->last_report_ns < metrics->report_ns) {
+		return false;
+	}
+
+	metrics->last_report_ns = now;
+
+	return true;
+}
+
+void metrics_progress(const metrics_t* metrics)
+{
+	double elapsed = seconds(metrics->last_report_ns - metrics->start_ns);
+	double lines_s = (double) metrics->lines_done / elapsed;
+	double mb_s = lines_s * (double) metrics->line_bytes / (1024 * 1024);
+	double eta = (double) (metrics->n_lines - metrics->lines_done) / lines_s;
+
+	fprintf(stdout,
+			" - %.1f%%: %.0f lines/s, %.1f MB/s, ETA %.0f s. Fill %.1f s, "
+			"inject %.1f s, compress %.1f s, write %.1f s.\n",
+			100.0 * (double) metrics->lines_done / (double) metrics->n_lines,
+			lines_s, mb_s, eta, seconds(metrics->fill_ns),
+			seconds(metrics->inject_ns), seconds(metrics->compress_ns),
+			seconds(metrics->write_ns));
+	fflush(stdout);
+}
+
+void metrics_reduce(metrics_t* metrics)
+{
+	if (parallel_size() == 1) {
+		return;
+	}
+
+	uint64_t sums[] = { metrics->n_lines, metrics->lines_done,
+						metrics->n_threads, metrics->fill_ns,
+						metrics->inject_ns, metrics->compress_ns,
+						metrics->transpose_ns, metrics->fill_stall_ns,
+						metrics->n_writes, metrics->write_bytes };
+	uint64_t maxima[] = { metrics->plan_ns, metrics->write_ns,
+						  metrics->write_stall_ns, metrics->elapsed_ns };
+
+	parallel_sum(sums, sizeof(sums) / sizeof(sums[0]));
+	parallel_max(maxima, sizeof(maxima) / sizeof(maxima[0]));
+
+	metrics->n_lines = sums[0];
+	metrics->lines_done = sums[1];
+	metrics->n_threads = (uint32_t) sums[2];
+	metrics->fill_ns = sums[3];
+	metrics->inject_ns = sums[4];
+	metrics->compress_ns = sums[5];
+	metrics->transpose_ns = sums[6];
+	metrics->fill_stall_ns = sums[7];
+	metrics->n_writes = sums[8];
+	metrics->write_bytes = sums[9];
+
+	metrics->plan_ns = maxima[0];
+	metrics->write_ns = maxima[1];
+	metrics->write_stall_ns = maxima[2];
+	metrics->elapsed_ns = maxima[3];
+}
+
+void metrics_print(const metrics_t* metrics)
+{
+	double elapsed = seconds(metrics->elapsed_ns);
+	double data_mb = (double) (metrics->lines_done * metrics->line_bytes)
+		/ (1024 * 1024);
+
+	fprintf(stdout, " - Wrote %.1f MB in %.3f s (%.0f lines/s, %.1f MB/s).\n",
+			data_mb, elapsed, (double) metrics->lines_done / elapsed,
+			data_mb / elapsed);
+	fprintf(stdout, " - %lu writes of %.1f MB took %.3f s.\n",
+			metrics->n_writes,
+			(double) metrics->write_bytes / (1024 * 1024),
+			seconds(metrics->write_ns));
+	fprintf(stdout,
+			" - Planning injections took %.3f s. %u workers spent %.3f s "
+			"filling, %.3f s injecting, %.3f s compressing and %.3f s "
+			"transposing.\n",
+			seconds(metrics->plan_ns), metrics->n_threads,
+			seconds(metrics->fill_ns), seconds(metrics->inject_ns),
+			seconds(metrics->compress_ns), seconds(metrics->transpose_ns));
+	fprintf(stdout,
+			" - Generation stalled %.3f s waiting for buffers, writing "
+			"stalled %.3f s waiting for blocks.\n",
+			seconds(metrics->fill_stall_ns), seconds(metrics->write_stall_ns));
+}
+
+oknok_t metrics_write_json(const metrics_t* metrics, const dataset_t* dataset,
+						   const uint64_t seed, const char* filename)
+{
+	FILE* file = fopen(filename, "w");
+	if (file == NULL) {
+		fprintf(stderr, "Error creating %s\n", filename);
+		return NOK;
+	}
+
+	double elapsed = seconds(metrics->elapsed_ns);
+	uint64_t bytes = metrics->lines_done * metrics->line_bytes;
+
+	fprintf(file, "{\n");
+	fprintf(file, "  \"mode\": \"%s\",\n", metrics->mode);
+	fprintf(file, "  \"seed\": %lu,\n", seed);
+	fprintf(file, "  \"n_classes\": %u,\n", dataset->n_classes);
+	fprintf(file, "  \"n_attributes\": %u,\n", dataset->n_attributes);
+	fprintf(file, "  \"n_observations\": %u,\n", dataset->n_observations);
+	fprintf(file, "  \"n_words\": %u,\n", dataset->n_words);
+	fprintf(file, "  \"n_threads\": %u,\n", metrics->n_threads);
+	fprintf(file, "  \"lines\": %lu,\n", metrics->lines_done);
+	fprintf(file, "  \"bytes\": %lu,\n", bytes);
+	fprintf(file, "  \"elapsed_s\": %.6f,\n", elapsed);
+	fprintf(file, "  \"lines_per_s\": %.1f,\n",
+			elapsed > 0 ? (double) metrics->lines_done / elapsed : 0.0);
+	fprintf(file, "  \"mb_per_s\": %.3f,\n",
+			elapsed > 0 ? (double) bytes / (1024 * 1024) / elapsed : 0.0);
+	fprintf(file, "  \"plan_s\": %.6f,\n", seconds(metrics->plan_ns));
+	fprintf(file, "  \"fill_s\": %.6f,\n", seconds(metrics->fill_ns));
+	fprintf(file, "  \"inject_s\": %.6f,\n", seconds(metrics->inject_ns));
+	fprintf(file, "  \"compress_s\": %.6f,\n", seconds(metrics->compress_ns));
+	fprintf(file, "  \"transpose_s\": %.6f,\n",
+			seconds(metrics->transpose_ns));
+	fprintf(file, "  \"write_s\": %.6f,\n", seconds(metrics->write_ns));
+	fprintf(file, "  \"writes\": %lu,\n", metrics->n_writes);
+	fprintf(file, "  \"write_bytes\": %lu,\n", metrics->write_bytes);
+	fprintf(file, "  \"fill_stall_s\": %.6f,\n",
+			seconds(metrics->fill_stall_ns));
+	fprintf(file, "  \"write_stall_s\": %.6f,\n",
+			seconds(metrics->write_stall_ns));
+	fprintf(file, "  \"close_s\": %.6f,\n", seconds(metrics->close_ns));
+	fprintf(file, "  \"stored_bytes\": %lu,\n", metrics->stored_bytes);
+	fprintf(file, "  \"file_bytes\": %lu\n", metrics->file_bytes);
+	fprintf(file, "}\n");
+
+	if (fclose(file) != 0) {
+		fprintf(stderr, "Error writing %s\n", filename);
+		return NOK;
+	}
+
+	return OK;
+}
@@ -0,0 +1,64 @@
+/*
+ ============================================================================
+ Name        : metrics.h
+ Author      : Eduardo Ribeiro
+ Description : Reports the progress and timings of a run
+ ============================================================================
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "types/dataset_t.h"
+#include "types/metrics_t.h"
+#include "types/oknok_t.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Seconds between progress reports
+ */
+#define METRICS_REPORT_S 5
+
+/**
+ * Clears the metrics of a run that writes n_lines lines of line_bytes bytes
+ */
+void metrics_init(metrics_t* metrics, const char* mode, const uint64_t n_lines,
+				  const uint64_t line_bytes, const uint32_t n_threads);
+
+/**
+ * Starts the clock
+ */
+void metrics_start(metrics_t* metrics);
+
+/**
+ * Is a progress report due? Only checks the clock
+ */
+bool metrics_due(metrics_t* metrics);
+
+/**
+ * Shows the lines written, throughput, ETA and where the time went. Under MPI
+ * these are rank 0's share of the lines
+ */
+void metrics_progress(const metrics_t* metrics);
+
+/**
+ * Gathers the metrics of every process on rank 0: counts and worker times
+ * add up, the wall times are those of the slowest process. Every process
+ * must call it
+ */
+void metrics_reduce(metrics_t* metrics);
+
+/**
+ * Shows the summary of a finished run
+ */
+void metrics_print(const metrics_t* metrics);
+
+/**
+ * Writes the summary of a finished run as JSON
+ */
+oknok_t metrics_write_json(const metrics_t* metrics, const dataset_t* dataset,
+						   const uint64_t seed, const char* filename);
+
+#endif
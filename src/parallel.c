@@ -0,0 +1,152 @@
+/*
+ ============================================================================
+ Name        : parallel.c
+ Author      : Eduardo Ribeiro
+ Description : Splits the work between MPI processes when built with
+			   parallel HDF5 (make mpi). Otherwise there is a single process
+ ============================================================================
+ */
+
+#include "parallel.h"
+
+#include "hdf5.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef H5_HAVE_PARALLEL
+#include <mpi.h>
+#endif
+
+void parallel_init(int* argc, char*** argv)
+{
+#ifdef H5_HAVE_PARALLEL
+	MPI_Init(argc, argv);
+
+	if (parallel_rank() != 0) {
+		if (freopen("/dev/null", "w", stdout) == NULL) {
+			fprintf(stderr, "Error silencing rank %d\n", parallel_rank());
+		}
+	}
+#else
+	(void) argc;
+	(void) argv;
+#endif
+}
+
+int parallel_rank(void)
+{
+	int rank = 0;
+
+#ifdef H5_HAVE_PARALLEL
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+#endif
+
+	return rank;
+}
+
+int parallel_size(void)
+{
+	int size = 1;
+
+#ifdef H5_HAVE_PARALLEL
+	MPI_Comm_size(MPI_COMM_WORLD, &size);
+#endif
+
+	return size;
+}
+
+void parallel_share(uint64_t* value)
+{
+#ifdef H5_HAVE_PARALLEL
+	MPI_Bcast(value, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+#else
+	(void) value;
+#endif
+}
+
+#ifdef H5_HAVE_PARALLEL
+/**
+ * Reduces the values of every process onto rank 0, in place
+ */
+static void reduce(uint64_t* values, const int n_values, MPI_Op op)
+{
+	if (parallel_rank() == 0) {
+		MPI_Reduce(MPI_IN_PLACE, values, n_values, MPI_UINT64_T, op, 0,
+				   MPI_COMM_WORLD);
+	} else {
+		MPI_Reduce(values, NULL, n_values, MPI_UINT64_T, op, 0,
+				   MPI_COMM_WORLD);
+	}
+}
+#endif
+
+void parallel_sum(uint64_t* values, const int n_values)
+{
+#ifdef H5_HAVE_PARALLEL
+	reduce(values, n_values, MPI_SUM);
+#else
+	(void) values;
+	(void) n_values;
+#endif
+}
+
+void parallel_max(uint64_t* values, const int n_values)
+{
+#ifdef H5_HAVE_PARALLEL
+	reduce(values, n_values, MPI_MAX);
+#else
+	(void) values;
+	(void) n_values;
+#endif
+}
+
+hid_t parallel_file_access(void)
+{
+	hid_t fapl_id = H5Pcreate(H5P_FILE_ACCESS);
+
+#ifdef H5_HAVE_PARALLEL
+	if (parallel_size() > 1) {
+		H5Pset_fapl_mpio(fapl_id, MPI_COMM_WORLD, MPI_INFO_NULL);
+	}
+#endif
+
+	return fapl_id;
+}
+
+void parallel_lines(const uint64_t n_lines, const uint64_t block_lines,
+					uint64_t* first_line, uint64_t* n_rank_lines)
+{
+	uint64_t rank = (uint64_t) parallel_rank();
+	uint64_t size = (uint64_t) parallel_size();
+
+	// Whole blocks, so chunks are never shared between processes
+	uint64_t n_blocks = (n_lines + block_lines - 1) / block_lines;
+	uint64_t first = rank * n_blocks / size * block_lines;
+	uint64_t last = (rank + 1) * n_blocks / size * block_lines;
+
+	if (first > n_lines) {
+		first = n_lines;
+	}
+	if (last > n_lines) {
+		last = n_lines;
+	}
+
+	*first_line = first;
+	*n_rank_lines = last - first;
+}
+
+void parallel_abort(void)
+{
+#ifdef H5_HAVE_PARALLEL
+	MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+#endif
+}
+
+void parallel_finalize(void)
+{
+#ifdef H5_HAVE_PARALLEL
+	MPI_Finalize();
+#endif
+}
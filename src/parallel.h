@@ -0,0 +1,71 @@
+/*
+ ============================================================================
+ Name        : parallel.h
+ Author      : Eduardo Ribeiro
+ Description : Splits the work between MPI processes when built with
+			   parallel HDF5 (make mpi). Otherwise there is a single process
+ ============================================================================
+ */
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include "hdf5.h"
+
+#include <stdint.h>
+
+/**
+ * Starts MPI. Only rank 0 reports progress on stdout
+ */
+void parallel_init(int* argc, char*** argv);
+
+/**
+ * Rank of this process
+ */
+int parallel_rank(void);
+
+/**
+ * Number of processes
+ */
+int parallel_size(void);
+
+/**
+ * Gives every process the value rank 0 has
+ */
+void parallel_share(uint64_t* value);
+
+/**
+ * Adds up the values of every process on rank 0. Every process must call it
+ */
+void parallel_sum(uint64_t* values, const int n_values);
+
+/**
+ * Keeps the largest of the values of every process on rank 0. Every process
+ * must call it
+ */
+void parallel_max(uint64_t* values, const int n_values);
+
+/**
+ * File access property list for a file shared by all processes
+ */
+hid_t parallel_file_access(void);
+
+/**
+ * Splits n_blocks blocks of block_lines lines, n_lines in total, between
+ * the processes and stores the lines this one generates
+ */
+void parallel_lines(const uint64_t n_lines, const uint64_t block_lines,
+					uint64_t* first_line, uint64_t* n_rank_lines);
+
+/**
+ * Stops every process after an error. A process that fails alone would
+ * leave the others waiting in collective calls
+ */
+void parallel_abort(void);
+
+/**
+ * Stops MPI
+ */
+void parallel_finalize(void);
+
+#endif
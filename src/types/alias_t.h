@@ -0,0 +1,32 @@
+/*
+ ============================================================================
+ Name        : alias_t.h
+ Author      : Eduardo Ribeiro
+ Description : Datatype representing an alias table to sample classes
+ ============================================================================
+ */
+
+#ifndef ALIAS_T_H__
+#define ALIAS_T_H__
+
+#include <stdint.h>
+
+typedef struct alias_t {
+	/**
+	 * Number of outcomes
+	 */
+	uint32_t n;
+
+	/**
+	 * Keep column i if the low 32 bits of the draw are below threshold[i].
+	 * 2^32 means always
+	 */
+	uint64_t* threshold;
+
+	/**
+	 * Outcome to return when column i is not kept
+	 */
+	uint32_t* alias;
+} alias_t;
+
+#endif // ALIAS_T_H__
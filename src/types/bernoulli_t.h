@@ -0,0 +1,46 @@
+/*
+ ============================================================================
+ Name        : bernoulli_t.h
+ Author      : Eduardo Ribeiro
+ Description : Datatype representing a word-at-a-time Bernoulli generator
+ ============================================================================
+ */
+
+#ifndef BERNOULLI_T_H__
+#define BERNOULLI_T_H__
+
+#include "types/word_t.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct bernoulli_t {
+	/**
+	 * Binary expansion of the probability, least significant bit first.
+	 * Trailing zeros are already removed
+	 */
+	uint32_t expansion;
+
+	/**
+	 * Number of random words combined to generate one word.
+	 * 0 means the probability is 0 or 1 and no draws are needed
+	 */
+	uint8_t n_draws;
+
+	/**
+	 * Word to return when no draws are needed
+	 */
+	word_t constant;
+
+	/**
+	 * Use geometric skips between set bits instead of whole words?
+	 */
+	bool sparse;
+
+	/**
+	 * log(1 - p), for the geometric skips
+	 */
+	double log_q;
+} bernoulli_t;
+
+#endif // BERNOULLI_T_H__
@@ -9,6 +9,7 @@
 #ifndef DATASET_T_H
 #define DATASET_T_H
 
+#include "../types/line_layout_t.h"
 #include "../types/word_t.h"
 
 #include <stdint.h>
@@ -44,6 +45,12 @@ typedef struct dataset_t {
 	 */
 	uint8_t n_bits_for_class;
 
+	/**
+	 * Where the class bits are, set with line_layout_init. fill_class_arrays
+	 * sets it when it is unset
+	 */
+	line_layout_t layout;
+
 	/**
 	 * Dataset data
 	 */
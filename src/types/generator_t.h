@@ -0,0 +1,187 @@
+/*
+ ============================================================================
+ Name        : generator_t.h
+ Author      : Eduardo Ribeiro
+ Description : Datatype representing a pool of line generation workers
+ ============================================================================
+ */
+
+#ifndef GENERATOR_T_H__
+#define GENERATOR_T_H__
+
+#include "types/dataset_t.h"
+#include "types/injection_plan_t.h"
+#include "types/sampler_t.h"
+#include "types/word_t.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct generator_t {
+	/**
+	 * Dataset being generated
+	 */
+	const dataset_t* dataset;
+
+	/**
+	 * How lines are drawn
+	 */
+	const sampler_t* sampler;
+
+	/**
+	 * Lines overwritten by inconsistencies and duplicates
+	 */
+	const injection_plan_t* injections;
+
+	/**
+	 * Number of worker threads
+	 */
+	uint32_t n_threads;
+
+	/**
+	 * Worker threads
+	 */
+	pthread_t* threads;
+
+	/**
+	 * Number of worker threads started
+	 */
+	uint32_t n_running;
+
+	/**
+	 * Workers that took their index, so each uses its own scratch
+	 */
+	uint32_t n_workers;
+
+	/**
+	 * Number of lines in a full block
+	 */
+	uint64_t block_lines;
+
+	/**
+	 * Ring of preallocated block buffers
+	 */
+	word_t* ring;
+
+	/**
+	 * Number of buffers in the ring
+	 */
+	uint32_t n_slots;
+
+	/**
+	 * Block stored in each slot, or UINT64_MAX if the slot is not ready
+	 */
+	uint64_t* slot_block;
+
+	/**
+	 * Lines and words of each compressed chunk.
+	 * chunk_lines is 0 when blocks are not compressed
+	 */
+	uint64_t chunk_lines;
+	uint32_t chunk_words;
+
+	/**
+	 * Deflate level of the chunks
+	 */
+	int compression_level;
+
+	/**
+	 * Number of chunks in a full block
+	 */
+	uint32_t block_chunks;
+
+	/**
+	 * Room for one compressed chunk
+	 */
+	size_t chunk_bound;
+
+	/**
+	 * Compressed chunks, block_chunks per slot
+	 */
+	uint8_t* packed;
+
+	/**
+	 * Size of each compressed chunk, or 0 if it failed
+	 */
+	size_t* packed_size;
+
+	/**
+	 * Room to build one chunk before it is compressed, per worker
+	 */
+	word_t* scratch;
+
+	/**
+	 * Attributes in the attribute-major copy of each block, or 0 when
+	 * there is no copy
+	 */
+	uint32_t column_attributes;
+
+	/**
+	 * Attribute-major copies, one per slot
+	 */
+	word_t* columns;
+
+	/**
+	 * First line and number of lines to generate
+	 */
+	uint64_t first_line;
+	uint64_t n_lines;
+
+	/**
+	 * Number of blocks to generate
+	 */
+	uint64_t n_blocks;
+
+	/**
+	 * Next block to be claimed by a worker
+	 */
+	uint64_t next_fill;
+
+	/**
+	 * Next block to be handed to the writer
+	 */
+	uint64_t next_write;
+
+	/**
+	 * Tells the workers to exit
+	 */
+	bool stop;
+
+	/**
+	 * Protects the ring state
+	 */
+	pthread_mutex_t lock;
+
+	/**
+	 * Signals the writer that a block is ready
+	 */
+	pthread_cond_t block_ready;
+
+	/**
+	 * Signals the workers that a slot was released
+	 */
+	pthread_cond_t slot_free;
+
+	/**
+	 * Time workers spent filling, injecting, compressing and transposing
+	 * blocks (sum over all workers)
+	 */
+	uint64_t fill_ns;
+	uint64_t inject_ns;
+	uint64_t compress_ns;
+	uint64_t transpose_ns;
+
+	/**
+	 * Time workers spent waiting for a free slot (sum over all workers)
+	 */
+	uint64_t fill_stall_ns;
+
+	/**
+	 * Time the writer spent waiting for the next block
+	 */
+	uint64_t write_stall_ns;
+} generator_t;
+
+#endif // GENERATOR_T_H__
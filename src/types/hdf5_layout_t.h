@@ -0,0 +1,49 @@
+/*
+ ============================================================================
+ Name        : hdf5_layout_t.h
+ Author      : Eduardo Ribeiro
+ Description : Datatype describing how a dataset is stored in the file
+ ============================================================================
+ */
+
+#ifndef HDF5_LAYOUT_T_H__
+#define HDF5_LAYOUT_T_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct hdf5_layout_t {
+	/**
+	 * Lines per chunk. 0 for a contiguous dataset
+	 */
+	uint64_t chunk_lines;
+
+	/**
+	 * Words per chunk. 0 for all the words of a line
+	 */
+	uint32_t chunk_words;
+
+	/**
+	 * Chunk cache size in bytes. 0 keeps the HDF5 default
+	 */
+	size_t chunk_cache_bytes;
+
+	/**
+	 * Shuffle and deflate the chunks?
+	 */
+	bool compress;
+
+	/**
+	 * Deflate level (0...9)
+	 */
+	unsigned int compression_level;
+
+	/**
+	 * Allocate the raw data when the dataset is created and never write
+	 * fill values
+	 */
+	bool no_fill;
+} hdf5_layout_t;
+
+#endif // HDF5_LAYOUT_T_H__
@@ -0,0 +1,73 @@
+/*
+ ============================================================================
+ Name        : hdf5_line_writer_t.h
+ Author      : Eduardo Ribeiro
+ Description : Datatype representing a stream of lines written to a dataset
+ ============================================================================
+ */
+
+#ifndef HDF5_LINE_WRITER_T_H__
+#define HDF5_LINE_WRITER_T_H__
+
+#include "hdf5.h"
+
+#include <stdint.h>
+
+typedef struct hdf5_line_writer_t {
+	/**
+	 * Dataset being written
+	 */
+	hid_t dataset_id;
+
+	/**
+	 * Memory type of the lines
+	 */
+	hid_t datatype;
+
+	/**
+	 * Dataset dataspace. Only the hyperslab moves between writes
+	 */
+	hid_t filespace_id;
+
+	/**
+	 * Buffer dataspace, resized when a block has fewer lines
+	 */
+	hid_t memspace_id;
+
+	/**
+	 * Transfer property list
+	 */
+	hid_t xfer_plist;
+
+	/**
+	 * Words per line
+	 */
+	uint32_t n_words;
+
+	/**
+	 * Lines in the buffer dataspace
+	 */
+	uint64_t memspace_lines;
+
+	/**
+	 * Where the next block goes
+	 */
+	uint64_t next_line;
+
+	/**
+	 * Bytes handed to HDF5
+	 */
+	uint64_t n_bytes;
+
+	/**
+	 * Number of H5Dwrite and H5Dwrite_chunk calls
+	 */
+	uint64_t n_calls;
+
+	/**
+	 * Time spent in those calls
+	 */
+	uint64_t write_ns;
+} hdf5_line_writer_t;
+
+#endif // HDF5_LINE_WRITER_T_H__
@@ -0,0 +1,31 @@
+/*
+ ============================================================================
+ Name        : injection_plan_t.h
+ Author      : Eduardo Ribeiro
+ Description : Datatype representing the inconsistencies and duplicates to
+			   add to a dataset
+ ============================================================================
+ */
+
+#ifndef INJECTION_PLAN_T_H__
+#define INJECTION_PLAN_T_H__
+
+#include "types/injection_t.h"
+
+#include <stdint.h>
+
+typedef struct injection_plan_t {
+	/**
+	 * Final content of every overwritten line, sorted by target line.
+	 * from is the generated line it is a copy of and class_shift the sum of
+	 * the shifts along the way
+	 */
+	injection_t* targets;
+
+	/**
+	 * Number of overwritten lines
+	 */
+	uint64_t n_targets;
+} injection_plan_t;
+
+#endif // INJECTION_PLAN_T_H__
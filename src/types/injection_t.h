@@ -0,0 +1,32 @@
+/*
+ ============================================================================
+ Name        : injection_t.h
+ Author      : Eduardo Ribeiro
+ Description : Datatype representing one inconsistency or duplicate
+ ============================================================================
+ */
+
+#ifndef INJECTION_T_H__
+#define INJECTION_T_H__
+
+#include <stdint.h>
+
+typedef struct injection_t {
+	/**
+	 * Line that is copied
+	 */
+	uint64_t from;
+
+	/**
+	 * Line that is overwritten
+	 */
+	uint64_t to;
+
+	/**
+	 * The copy gets class (class + class_shift) % n_classes.
+	 * 0 for duplicates
+	 */
+	uint32_t class_shift;
+} injection_t;
+
+#endif // INJECTION_T_H__
@@ -0,0 +1,45 @@
+/*
+ ============================================================================
+ Name        : line_layout_t.h
+ Author      : Eduardo Ribeiro
+ Description : Datatype representing where the class bits are in a line
+ ============================================================================
+ */
+
+#ifndef LINE_LAYOUT_T_H__
+#define LINE_LAYOUT_T_H__
+
+#include "../types/word_t.h"
+
+#include <stdint.h>
+
+/**
+ * The class is
+ * ((line[high_word] >> high_shift) & high_mask) << low_bits
+ *   | ((line[n_words - 1] >> low_shift) & low_mask)
+ * When the class fits in the last word high_word is the last word and
+ * low_mask is 0, so the same expression works for every line layout
+ */
+typedef struct line_layout_t {
+	/**
+	 * Number of words in a line
+	 */
+	uint32_t n_words;
+
+	/**
+	 * Word with the high class bits and where they start
+	 */
+	uint32_t high_word;
+	uint8_t high_shift;
+	word_t high_mask;
+
+	/**
+	 * Number of class bits on the last word when the class is split, and
+	 * where they start
+	 */
+	uint8_t low_bits;
+	uint8_t low_shift;
+	word_t low_mask;
+} line_layout_t;
+
+#endif // LINE_LAYOUT_T_H__
@@ -0,0 +1,93 @@
+/*
+ ============================================================================
+ Name        : metrics_t.h
+ Author      : Eduardo Ribeiro
+ Description : Datatype representing the progress and timings of a run
+ ============================================================================
+ */
+
+#ifndef METRICS_T_H__
+#define METRICS_T_H__
+
+#include <stdint.h>
+
+typedef struct metrics_t {
+	/**
+	 * What the run does: create, append, resume or inject
+	 */
+	const char* mode;
+
+	/**
+	 * Lines this run writes and their size
+	 */
+	uint64_t n_lines;
+	uint64_t line_bytes;
+
+	/**
+	 * Lines written so far
+	 */
+	uint64_t lines_done;
+
+	/**
+	 * Number of worker threads
+	 */
+	uint32_t n_threads;
+
+	/**
+	 * When writing started and when progress was last shown
+	 */
+	uint64_t start_ns;
+	uint64_t last_report_ns;
+
+	/**
+	 * Time between progress reports
+	 */
+	uint64_t report_ns;
+
+	/**
+	 * Time drawing the injection plan
+	 */
+	uint64_t plan_ns;
+
+	/**
+	 * Time the workers spent filling, injecting, compressing and
+	 * transposing lines (sum over all workers). With --inject, inject_ns is
+	 * the time reading and writing the changed lines
+	 */
+	uint64_t fill_ns;
+	uint64_t inject_ns;
+	uint64_t compress_ns;
+	uint64_t transpose_ns;
+
+	/**
+	 * Time in write calls, their number and the bytes written
+	 */
+	uint64_t write_ns;
+	uint64_t n_writes;
+	uint64_t write_bytes;
+
+	/**
+	 * Time workers waited for a free buffer (sum over all workers) and
+	 * the writer waited for the next block
+	 */
+	uint64_t fill_stall_ns;
+	uint64_t write_stall_ns;
+
+	/**
+	 * Time from the start of writing until the last line was written
+	 */
+	uint64_t elapsed_ns;
+
+	/**
+	 * Time closing the file
+	 */
+	uint64_t close_ns;
+
+	/**
+	 * Bytes the dataset takes in the file and size of the file
+	 */
+	uint64_t stored_bytes;
+	uint64_t file_bytes;
+} metrics_t;
+
+#endif // METRICS_T_H__
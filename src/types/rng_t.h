@@ -0,0 +1,36 @@
+/*
+ ============================================================================
+ Name        : rng_t.h
+ Author      : Eduardo Ribeiro
+ Description : Datatype representing the state of a random number generator
+ ============================================================================
+ */
+
+#ifndef RNG_T_H__
+#define RNG_T_H__
+
+#include <stdint.h>
+
+typedef struct rng_t {
+	/**
+	 * Philox key: the seed
+	 */
+	uint32_t key[2];
+
+	/**
+	 * Philox counter: position (low) and domain/stream (high)
+	 */
+	uint32_t counter[4];
+
+	/**
+	 * Position of the next 64 bit draw in the stream
+	 */
+	uint64_t position;
+
+	/**
+	 * Last generated block. Each block holds two draws
+	 */
+	uint64_t block[2];
+} rng_t;
+
+#endif // RNG_T_H__
@@ -0,0 +1,34 @@
+/*
+ ============================================================================
+ Name        : sampler_t.h
+ Author      : Eduardo Ribeiro
+ Description : Datatype describing how random lines are drawn
+ ============================================================================
+ */
+
+#ifndef SAMPLER_T_H__
+#define SAMPLER_T_H__
+
+#include "types/alias_t.h"
+#include "types/bernoulli_t.h"
+
+#include <stdint.h>
+
+typedef struct sampler_t {
+	/**
+	 * Attribute bit generator
+	 */
+	bernoulli_t bernoulli;
+
+	/**
+	 * Class distribution
+	 */
+	alias_t classes;
+
+	/**
+	 * Seed for the random number generator
+	 */
+	uint64_t seed;
+} sampler_t;
+
+#endif // SAMPLER_T_H__
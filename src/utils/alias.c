@@ -0,0 +1,139 @@
+/*
+ ============================================================================
+ Name        : utils/alias.c
+ Author      : Eduardo Ribeiro
+ Description : Alias tables to sample discrete distributions in O(1)
+ ============================================================================
+ */
+
+#include "utils/alias.h"
+
+#include "types/alias_t.h"
+#include "types/oknok_t.h"
+#include "utils/random.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * Threshold for a column that is always kept
+ */
+#define ALIAS_ALWAYS (UINT64_C(1) << 32)
+
+/**
+ * Vose's algorithm, using the preallocated scaled probabilities and
+ * worklists
+ */
+static oknok_t alias_build(alias_t* alias, const double* weights,
+						   double* scaled, uint32_t* small, uint32_t* large)
+{
+	uint32_t n = alias->n;
+
+	double total = 0;
+	for (uint32_t i = 0; i < n; i++) {
+		double w = weights == NULL ? 1.0 : weights[i];
+
+		// Comparisons with NaN are false, so test for what is allowed
+		if (!(isfinite(w) && w >= 0)) {
+			fprintf(stderr, "Class weights must be finite and not negative\n");
+			return NOK;
+		}
+		total += w;
+	}
+
+	if (!(isfinite(total) && total > 0)) {
+		fprintf(stderr, "Class weights must add up to a positive number\n");
+		return NOK;
+	}
+
+	uint32_t n_small = 0;
+	uint32_t n_large = 0;
+
+	// Probabilities scaled so the mean is 1
+	for (uint32_t i = 0; i < n; i++) {
+		scaled[i] = (weights == NULL ? 1.0 : weights[i]) * n / total;
+
+		if (scaled[i] < 1.0) {
+			small[n_small++] = i;
+		} else {
+			large[n_large++] = i;
+		}
+	}
+
+	// Each small column is topped up by one large column
+	while (n_small > 0 && n_large > 0) {
+		uint32_t s = small[--n_small];
+		uint32_t l = large[--n_large];
+
+		alias->threshold[s] = (uint64_t) (scaled[s] * (double) ALIAS_ALWAYS);
+		alias->alias[s] = l;
+
+		scaled[l] -= 1.0 - scaled[s];
+
+		if (scaled[l] < 1.0) {
+			small[n_small++] = l;
+		} else {
+			large[n_large++] = l;
+		}
+	}
+
+	// Whatever remains is 1 up to rounding errors
+	while (n_large > 0) {
+		uint32_t l = large[--n_large];
+		alias->threshold[l] = ALIAS_ALWAYS;
+		alias->alias[l] = l;
+	}
+
+	while (n_small > 0) {
+		uint32_t s = small[--n_small];
+		alias->threshold[s] = ALIAS_ALWAYS;
+		alias->alias[s] = s;
+	}
+
+	return OK;
+}
+
+oknok_t alias_init(alias_t* alias, const double* weights, const uint32_t n)
+{
+	alias->n = n;
+	alias->threshold = (uint64_t*) malloc(sizeof(uint64_t) * n);
+	alias->alias = (uint32_t*) malloc(sizeof(uint32_t) * n);
+
+	double* scaled = (double*) malloc(sizeof(double) * n);
+	uint32_t* small = (uint32_t*) malloc(sizeof(uint32_t) * n);
+	uint32_t* large = (uint32_t*) malloc(sizeof(uint32_t) * n);
+
+	oknok_t status = NOK;
+
+	if (alias->threshold == NULL || alias->alias == NULL || scaled == NULL
+		|| small == NULL || large == NULL) {
+		fprintf(stderr, "Error allocating alias table for %u classes\n", n);
+	} else {
+		status = alias_build(alias, weights, scaled, small, large);
+	}
+
+	free(large);
+	free(small);
+	free(scaled);
+
+	return status;
+}
+
+uint32_t alias_sample(const alias_t* alias, const uint64_t r)
+{
+	uint32_t column = rng_bounded(r, alias->n);
+
+	return (uint32_t) r < alias->threshold[column] ? column
+												   : alias->alias[column];
+}
+
+void alias_free(alias_t* alias)
+{
+	free(alias->threshold);
+	free(alias->alias);
+
+	alias->threshold = NULL;
+	alias->alias = NULL;
+}
@@ -0,0 +1,36 @@
+/*
+ ============================================================================
+ Name        : utils/alias.h
+ Author      : Eduardo Ribeiro
+ Description : Alias tables to sample discrete distributions in O(1)
+ ============================================================================
+ */
+
+#ifndef UTILS_ALIAS_H
+#define UTILS_ALIAS_H
+
+#include "types/alias_t.h"
+#include "types/oknok_t.h"
+
+#include <stdint.h>
+
+/**
+ * Builds the alias table for n outcomes with the given weights.
+ * If weights is NULL all outcomes are equally likely.
+ * Vose, "A linear algorithm for generating random numbers with a given
+ * distribution", 1991
+ */
+oknok_t alias_init(alias_t* alias, const double* weights, const uint32_t n);
+
+/**
+ * Returns one outcome from 64 random bits: the high 32 bits pick a column,
+ * the low 32 bits decide between the column and its alias
+ */
+uint32_t alias_sample(const alias_t* alias, const uint64_t r);
+
+/**
+ * Frees the alias table
+ */
+void alias_free(alias_t* alias);
+
+#endif // UTILS_ALIAS_H
@@ -11,6 +11,19 @@
 
 #include <stdint.h>
 
+/**
+ * Widest vector kernel available for this build
+ */
+#if !defined(BIT_FORCE_SCALAR) && defined(__AVX512F__)
+#define BIT_AVX512
+#elif !defined(BIT_FORCE_SCALAR) && defined(__AVX2__)
+#define BIT_AVX2
+#endif
+
+#if defined(BIT_AVX512) || defined(BIT_AVX2)
+#include <immintrin.h>
+#endif
+
 word_t set_bits(const word_t destination, const word_t source, const uint8_t at,
 				const uint8_t numbits)
 {
@@ -47,7 +60,7 @@ word_t get_bits(const word_t source, const uint8_t at, const uint8_t numbits)
  * https://stackoverflow.com/questions/41778362/
  * how-to-efficiently-transpose-a-2d-bit-matrix
  */
-void transpose64(uint64_t a[64])
+void transpose64_scalar(uint64_t a[64])
 {
 	int j, k;
 	uint64_t m, t;
@@ -60,3 +73,153 @@ void transpose64(uint64_t a[64])
 		}
 	}
 }
+
+#if defined(BIT_AVX512)
+/**
+ * Swaps the rows k and k + j of the network, j >= 8: whole vectors of 8 rows
+ */
+static void transpose64_rows_avx512(__m512i v[8], const int j,
+									const uint64_t mask)
+{
+	const __m512i m = _mm512_set1_epi64((long long) mask);
+	const __m128i shift = _mm_cvtsi32_si128(j);
+	const int step = j / 8;
+
+	for (int k = 0; k < 8; k = ((k | step) + 1) & ~step) {
+		__m512i t = _mm512_and_si512(
+			_mm512_xor_si512(v[k], _mm512_srl_epi64(v[k + step], shift)), m);
+
+		v[k] = _mm512_xor_si512(v[k], t);
+		v[k + step]
+			= _mm512_xor_si512(v[k + step], _mm512_sll_epi64(t, shift));
+	}
+}
+
+/**
+ * Swaps the rows k and k + j of the network, j < 8: lanes of one vector.
+ * upper has the lanes i with i & j set
+ */
+static __m512i transpose64_lanes_avx512(const __m512i v, const int j,
+										const uint64_t mask,
+										const __mmask8 upper)
+{
+	const __m512i m = _mm512_set1_epi64((long long) mask);
+	const __m128i shift = _mm_cvtsi32_si128(j);
+	const __m512i partner
+		= _mm512_xor_si512(_mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0),
+						   _mm512_set1_epi64(j));
+
+	__m512i y = _mm512_permutexvar_epi64(partner, v);
+	__m512i t
+		= _mm512_and_si512(_mm512_xor_si512(v, _mm512_srl_epi64(y, shift)), m);
+	__m512i moved
+		= _mm512_sll_epi64(_mm512_permutexvar_epi64(partner, t), shift);
+
+	return _mm512_mask_blend_epi64(upper, _mm512_xor_si512(v, t),
+								   _mm512_xor_si512(v, moved));
+}
+
+static void transpose64_avx512(uint64_t a[64])
+{
+	__m512i v[8];
+
+	for (int i = 0; i < 8; i++) {
+		v[i] = _mm512_loadu_si512((const void*) (a + 8 * i));
+	}
+
+	transpose64_rows_avx512(v, 32, 0x00000000FFFFFFFF);
+	transpose64_rows_avx512(v, 16, 0x0000FFFF0000FFFF);
+	transpose64_rows_avx512(v, 8, 0x00FF00FF00FF00FF);
+
+	for (int i = 0; i < 8; i++) {
+		v[i] = transpose64_lanes_avx512(v[i], 4, 0x0F0F0F0F0F0F0F0F, 0xF0);
+		v[i] = transpose64_lanes_avx512(v[i], 2, 0x3333333333333333, 0xCC);
+		v[i] = transpose64_lanes_avx512(v[i], 1, 0x5555555555555555, 0xAA);
+		_mm512_storeu_si512((void*) (a + 8 * i), v[i]);
+	}
+}
+#endif
+
+#if defined(BIT_AVX2)
+/**
+ * Swaps the rows k and k + j of the network, j >= 4: whole vectors of 4 rows
+ */
+static void transpose64_rows_avx2(__m256i v[16], const int j,
+								  const uint64_t mask)
+{
+	const __m256i m = _mm256_set1_epi64x((long long) mask);
+	const __m128i shift = _mm_cvtsi32_si128(j);
+	const int step = j / 4;
+
+	for (int k = 0; k < 16; k = ((k | step) + 1) & ~step) {
+		__m256i t = _mm256_and_si256(
+			_mm256_xor_si256(v[k], _mm256_srl_epi64(v[k + step], shift)), m);
+
+		v[k] = _mm256_xor_si256(v[k], t);
+		v[k + step]
+			= _mm256_xor_si256(v[k + step], _mm256_sll_epi64(t, shift));
+	}
+}
+
+static void transpose64_avx2(uint64_t a[64])
+{
+	__m256i v[16];
+
+	for (int i = 0; i < 16; i++) {
+		v[i] = _mm256_loadu_si256((const __m256i*) (a + 4 * i));
+	}
+
+	transpose64_rows_avx2(v, 32, 0x00000000FFFFFFFF);
+	transpose64_rows_avx2(v, 16, 0x0000FFFF0000FFFF);
+	transpose64_rows_avx2(v, 8, 0x00FF00FF00FF00FF);
+	transpose64_rows_avx2(v, 4, 0x0F0F0F0F0F0F0F0F);
+
+	const __m256i m2 = _mm256_set1_epi64x(0x3333333333333333);
+	const __m256i m1 = _mm256_set1_epi64x(0x5555555555555555);
+
+	for (int i = 0; i < 16; i++) {
+		// Lanes 0, 1 with 2, 3
+		__m256i y = _mm256_permute4x64_epi64(v[i], 0x4E);
+		__m256i t = _mm256_and_si256(
+			_mm256_xor_si256(v[i], _mm256_srli_epi64(y, 2)), m2);
+		__m256i moved
+			= _mm256_slli_epi64(_mm256_permute4x64_epi64(t, 0x4E), 2);
+		v[i] = _mm256_blend_epi32(_mm256_xor_si256(v[i], t),
+								  _mm256_xor_si256(v[i], moved), 0xF0);
+
+		// Lanes 0, 2 with 1, 3
+		y = _mm256_permute4x64_epi64(v[i], 0xB1);
+		t = _mm256_and_si256(_mm256_xor_si256(v[i], _mm256_srli_epi64(y, 1)),
+							 m1);
+		moved = _mm256_slli_epi64(_mm256_permute4x64_epi64(t, 0xB1), 1);
+		v[i] = _mm256_blend_epi32(_mm256_xor_si256(v[i], t),
+								  _mm256_xor_si256(v[i], moved), 0xCC);
+
+		_mm256_storeu_si256((__m256i*) (a + 4 * i), v[i]);
+	}
+}
+#endif
+
+void transpose64(uint64_t a[64])
+{
+#if defined(BIT_AVX512)
+	transpose64_avx512(a);
+#elif defined(BIT_AVX2)
+	transpose64_avx2(a);
+#else
+	transpose64_scalar(a);
+#endif
+}
+
+const char* transpose64_kernel(void)
+{
+#if defined(BIT_AVX512)
+	return "avx512";
+#elif defined(BIT_AVX2)
+	return "avx2";
+#elif defined(BIT_FORCE_SCALAR)
+	return "scalar (forced)";
+#else
+	return "scalar";
+#endif
+}
@@ -119,8 +119,19 @@ word_t invert_n_bits(word_t source, uint8_t numbits);
 word_t get_bits(const word_t source, const uint8_t at, const uint8_t numbits);
 
 /**
- * Transposes a 64x64 bit matrix
+ * Transposes a 64x64 bit matrix: bit 63 - c of row r goes to bit 63 - r of
+ * row c. Uses the widest vector kernel of the build
  */
 void transpose64(uint64_t a[64]);
 
+/**
+ * Scalar transpose64, the reference for the vector kernels
+ */
+void transpose64_scalar(uint64_t a[64]);
+
+/**
+ * Name of the transpose64 kernel in use
+ */
+const char* transpose64_kernel(void);
+
 #endif // UTILS_BIT_H
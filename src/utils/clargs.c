@@ -10,8 +10,11 @@
 
 #include "utils/cargs.h"
 
+#include <ctype.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 #include <unistd.h>
 
 int read_args(int argc, char** argv, clargs_t* args)
@@ -32,6 +35,29 @@ int read_args(int argc, char** argv, clargs_t* args)
 	args->n_duplicates = N_DUPLICATES_DEFAULT;
 	args->compress_dataset = COMPRESS_DATASET;
 	args->compression_level = ZLIB_COMPRESSION_LEVEL;
+	args->n_threads = N_THREADS_DEFAULT;
+	args->block_lines = BLOCK_LINES_DEFAULT;
+	args->block_mb = BLOCK_MB_DEFAULT;
+	args->n_ring_slots = RING_SLOTS_DEFAULT;
+	args->write_mode = WRITE_BLOCKS;
+	args->class_weights = NULL;
+	args->inject_only = false;
+	args->chunk_lines = CHUNK_LINES_DEFAULT;
+	args->chunk_words = CHUNK_WORDS_DEFAULT;
+	args->chunk_cache_mb = CHUNK_CACHE_MB_DEFAULT;
+	args->direct_chunks = false;
+	args->in_memory = false;
+	args->io_profile = false;
+	args->append = false;
+	args->resume = false;
+	args->checkpoint_s = CHECKPOINT_S_DEFAULT;
+	args->metrics_json = NULL;
+	args->column_data = false;
+
+	// Without --seed every run gets a new dataset
+	struct timespec tick;
+	clock_gettime(CLOCK_MONOTONIC_RAW, &tick);
+	args->seed = (uint64_t) tick.tv_sec * 1000000000 + (uint64_t) tick.tv_nsec;
 
 	/**
 	 * This is the main configuration of all options available.
@@ -91,6 +117,139 @@ int read_args(int argc, char** argv, clargs_t* args)
 			  .value_name = "compression",
 			  .description = "Compression level (0...9)" },
 
+			{ .identifier = 's',
+			  .access_letters = "s",
+			  .access_name = "seed",
+			  .value_name = "seed",
+			  .description = "Seed for the random number generator" },
+
+			{ .identifier = 't',
+			  .access_letters = "t",
+			  .access_name = "threads",
+			  .value_name = "threads",
+			  .description = "Number of threads generating lines (1 to "
+							 "1024)" },
+
+			{ .identifier = 'b',
+			  .access_letters = "b",
+			  .access_name = "block-lines",
+			  .value_name = "lines",
+			  .description = "Lines generated and written per block" },
+
+			{ .identifier = 'B',
+			  .access_letters = "B",
+			  .access_name = "block-mb",
+			  .value_name = "MB",
+			  .description = "Block size in MB (default 1)" },
+
+			{ .identifier = 'r',
+			  .access_letters = NULL,
+			  .access_name = "ring-slots",
+			  .value_name = "blocks",
+			  .description = "Block buffers shared by generation and writing "
+							 "(default 2 per thread)" },
+
+			{ .identifier = 'l',
+			  .access_letters = NULL,
+			  .access_name = "per-line",
+			  .value_name = NULL,
+			  .description = "Write one line per call (baseline)" },
+
+			{ .identifier = 'L',
+			  .access_letters = NULL,
+			  .access_name = "per-line-writer",
+			  .value_name = NULL,
+			  .description = "Write one line per call, reusing the "
+							 "dataspaces" },
+
+			{ .identifier = 'w',
+			  .access_letters = "w",
+			  .access_name = "class-weights",
+			  .value_name = "weights",
+			  .description = "Class weights: file or comma separated list" },
+
+			{ .identifier = 'j',
+			  .access_letters = NULL,
+			  .access_name = "inject",
+			  .value_name = NULL,
+			  .description = "Add the inconsistencies and duplicates to an "
+							 "existing dataset" },
+
+			{ .identifier = 'k',
+			  .access_letters = NULL,
+			  .access_name = "chunk-lines",
+			  .value_name = "lines",
+			  .description = "Store the dataset in chunks of this many lines "
+							 "(default one block)" },
+
+			{ .identifier = 'K',
+			  .access_letters = NULL,
+			  .access_name = "chunk-words",
+			  .value_name = "words",
+			  .description = "Words per chunk (default a whole line)" },
+
+			{ .identifier = 'm',
+			  .access_letters = NULL,
+			  .access_name = "chunk-cache-mb",
+			  .value_name = "MB",
+			  .description = "Chunk cache size in MB" },
+
+			{ .identifier = 'D',
+			  .access_letters = NULL,
+			  .access_name = "direct-chunks",
+			  .value_name = NULL,
+			  .description = "Compress chunks in the generator threads and "
+							 "write them directly (needs -z)" },
+
+			{ .identifier = 'M',
+			  .access_letters = NULL,
+			  .access_name = "in-memory",
+			  .value_name = NULL,
+			  .description = "Build the file in memory and write it once "
+							 "at the end (no checkpoints until then)" },
+
+			{ .identifier = 'I',
+			  .access_letters = NULL,
+			  .access_name = "io-profile",
+			  .value_name = NULL,
+			  .description = "Align to the filesystem blocks, allocate early, "
+							 "skip fill values and use the latest format" },
+
+			{ .identifier = 'A',
+			  .access_letters = NULL,
+			  .access_name = "append",
+			  .value_name = NULL,
+			  .description = "Add -o observations to an existing chunked "
+							 "dataset (repeat -a, -c and -z)" },
+
+			{ .identifier = 'R',
+			  .access_letters = NULL,
+			  .access_name = "resume",
+			  .value_name = NULL,
+			  .description = "Continue an interrupted run from its last "
+							 "checkpoint (repeat the other options)" },
+
+			{ .identifier = 'C',
+			  .access_letters = NULL,
+			  .access_name = "checkpoint-s",
+			  .value_name = "seconds",
+			  .description = "Seconds between checkpoints (default 60, 0 "
+							 "after every block)" },
+
+			{ .identifier = 'J',
+			  .access_letters = NULL,
+			  .access_name = "metrics-json",
+			  .value_name = "filename",
+			  .description = "Write the throughput and timings of the run "
+							 "as JSON" },
+
+			{ .identifier = 'T',
+			  .access_letters = NULL,
+			  .access_name = "column-data",
+			  .value_name = NULL,
+			  .description = "Also write an attribute-major copy in "
+							 "/COLUMN_DATA" },
+
 			{ .identifier = 'h',
 			  .access_letters = "h",
 			  .access_name = "help",
@@ -142,6 +301,77 @@ int read_args(int argc, char** argv, clargs_t* args)
 			args->compress_dataset = USE_COMPRESSION;
 			args->compression_level = strtol(value, &end, 10);
 			break;
+		case 's':
+			value = cag_option_get_value(&context);
+			args->seed = strtoull(value, &end, 10);
+			break;
+		case 't':
+			value = cag_option_get_value(&context);
+			args->n_threads = strtol(value, &end, 10);
+			break;
+		case 'b':
+			value = cag_option_get_value(&context);
+			args->block_lines = strtol(value, &end, 10);
+			break;
+		case 'B':
+			value = cag_option_get_value(&context);
+			args->block_mb = strtod(value, &end);
+			break;
+		case 'r':
+			value = cag_option_get_value(&context);
+			args->n_ring_slots = strtol(value, &end, 10);
+			break;
+		case 'l':
+			args->write_mode = WRITE_LINES;
+			break;
+		case 'L':
+			args->write_mode = WRITE_LINES_WRITER;
+			break;
+		case 'w':
+			value = cag_option_get_value(&context);
+			args->class_weights = value;
+			break;
+		case 'j':
+			args->inject_only = true;
+			break;
+		case 'k':
+			value = cag_option_get_value(&context);
+			args->chunk_lines = strtol(value, &end, 10);
+			break;
+		case 'K':
+			value = cag_option_get_value(&context);
+			args->chunk_words = strtol(value, &end, 10);
+			break;
+		case 'm':
+			value = cag_option_get_value(&context);
+			args->chunk_cache_mb = strtod(value, &end);
+			break;
+		case 'D':
+			args->direct_chunks = true;
+			break;
+		case 'M':
+			args->in_memory = true;
+			break;
+		case 'I':
+			args->io_profile = true;
+			break;
+		case 'A':
+			args->append = true;
+			break;
+		case 'R':
+			args->resume = true;
+			break;
+		case 'C':
+			value = cag_option_get_value(&context);
+			args->checkpoint_s = strtod(value, &end);
+			break;
+		case 'J':
+			value = cag_option_get_value(&context);
+			args->metrics_json = value;
+			break;
+		case 'T':
+			args->column_data = true;
+			break;
 		case 'h':
 			printf("Usage: %s [OPTION]...\n", argv[0]);
 			cag_option_print(options, CAG_ARRAY_SIZE(options), stdout);
@@ -151,7 +381,14 @@ int read_args(int argc, char** argv, clargs_t* args)
 
 	if (args->filename == NULL || args->datasetname == NULL
 		|| args->n_attributes < 2 || args->n_observations < 2
-		|| args->n_classes < 2) {
+		|| args->n_classes < 2 || args->n_threads < 1
+		|| args->n_threads > N_THREADS_MAX
+		|| args->block_mb < 0 || args->chunk_cache_mb < 0
+		|| args->checkpoint_s < 0 || args->compression_level > 9
+		|| (args->append && (args->resume || args->column_data))
+		|| (args->direct_chunks
+			&& (args->compress_dataset != USE_COMPRESSION || args->append
+				|| args->resume))) {
 		printf("Usage: %s [OPTION]...\n", argv[0]);
 		cag_option_print(options, CAG_ARRAY_SIZE(options), stdout);
 		return READ_CL_ARGS_NOK;
@@ -159,3 +396,75 @@ int read_args(int argc, char** argv, clargs_t* args)
 
 	return READ_CL_ARGS_OK;
 }
+
+int read_class_weights(const char* value, const unsigned long n_classes,
+					   double* weights)
+{
+	char* text = NULL;
+
+	FILE* file = fopen(value, "r");
+	if (file != NULL) {
+		fseek(file, 0, SEEK_END);
+		long size = ftell(file);
+		fseek(file, 0, SEEK_SET);
+
+		text = (char*) malloc((size_t) size + 1);
+		if (text == NULL) {
+			fprintf(stderr, "Error reading class weights from %s\n", value);
+			fclose(file);
+			return READ_CL_ARGS_NOK;
+		}
+
+		text[fread(text, 1, (size_t) size, file)] = '\0';
+		fclose(file);
+	}
+
+	const char* c = (text != NULL) ? text : value;
+	char* end = NULL;
+	unsigned long n_weights = 0;
+	int status = READ_CL_ARGS_OK;
+
+	while (*c != '\0') {
+		if (*c == ',' || isspace((unsigned char) *c)) {
+			c++;
+			continue;
+		}
+
+		if (n_weights == n_classes) {
+			// Too many weights
+			n_weights++;
+			break;
+		}
+
+		// strtod also reads nan, inf and numbers too large for a double
+		double weight = strtod(c, &end);
+		if (end == c || !isfinite(weight) || weight < 0) {
+			fprintf(stderr, "Invalid class weight: %s\n", c);
+			status = READ_CL_ARGS_NOK;
+			break;
+		}
+
+		weights[n_weights++] = weight;
+		c = end;
+	}
+
+	if (status == READ_CL_ARGS_OK && n_weights != n_classes) {
+		fprintf(stderr, "Expected %lu class weights\n", n_classes);
+		status = READ_CL_ARGS_NOK;
+	}
+
+	double total = 0;
+	for (unsigned long i = 0; status == READ_CL_ARGS_OK && i < n_weights;
+		 i++) {
+		total += weights[i];
+	}
+
+	if (status == READ_CL_ARGS_OK && !(isfinite(total) && total > 0)) {
+		fprintf(stderr, "Class weights must add up to a positive number\n");
+		status = READ_CL_ARGS_NOK;
+	}
+
+	free(text);
+
+	return status;
+}
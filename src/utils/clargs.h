@@ -9,6 +9,9 @@
 #ifndef CL_ARGS_H
 #define CL_ARGS_H
 
+#include <stdbool.h>
+#include <stdint.h>
+
 /**
  * Do not edit
  */
@@ -44,6 +47,54 @@
  */
 #define N_DUPLICATES_DEFAULT 2
 
+/**
+ * Number of threads generating lines by default
+ */
+#define N_THREADS_DEFAULT 1
+
+/**
+ * Most threads generating lines. strtol turns -1 into a huge count
+ */
+#define N_THREADS_MAX 1024
+
+/**
+ * Lines generated and written per block by default.
+ * 0 sizes the block from BLOCK_MB_DEFAULT
+ */
+#define BLOCK_LINES_DEFAULT 0
+
+/**
+ * Size of each block in MB by default
+ */
+#define BLOCK_MB_DEFAULT 1.0
+
+/**
+ * Number of block buffers in the generate/write ring.
+ * 0 uses two per thread
+ */
+#define RING_SLOTS_DEFAULT 0
+
+/**
+ * Lines per chunk by default. 0 sizes chunks like blocks when the dataset is
+ * chunked
+ */
+#define CHUNK_LINES_DEFAULT 0
+
+/**
+ * Words per chunk by default. 0 for all the words of a line
+ */
+#define CHUNK_WORDS_DEFAULT 0
+
+/**
+ * Chunk cache size in MB by default. 0 keeps the HDF5 default
+ */
+#define CHUNK_CACHE_MB_DEFAULT 0.0
+
+/**
+ * Seconds between checkpoints by default
+ */
+#define CHECKPOINT_S_DEFAULT 60.0
+
 /**
  * Compress the dataset?
  */
@@ -63,6 +114,10 @@
 #define DONT_USE_COMPRESSION 0
 #define USE_COMPRESSION 1
 
+#define WRITE_BLOCKS 0
+#define WRITE_LINES 1
+#define WRITE_LINES_WRITER 2
+
 /**
  * Structure to store command line options
  */
@@ -116,6 +171,105 @@ typedef struct clargs_t {
 	 * Dataset compression level
 	 */
 	unsigned char compression_level;
+
+	/**
+	 * Seed for the random number generator
+	 */
+	uint64_t seed;
+
+	/**
+	 * Number of threads generating lines
+	 */
+	unsigned long n_threads;
+
+	/**
+	 * Number of lines per block. If 0, block_mb is used
+	 */
+	unsigned long block_lines;
+
+	/**
+	 * Size of each block in MB
+	 */
+	double block_mb;
+
+	/**
+	 * Number of block buffers in the generate/write ring
+	 */
+	unsigned long n_ring_slots;
+
+	/**
+	 * Write each block at once, or line by line with new dataspaces for
+	 * every line (the baseline) or with the line writer
+	 */
+	unsigned char write_mode;
+
+	/**
+	 * Class weights: a file or a comma separated list.
+	 * NULL for equally likely classes
+	 */
+	const char* class_weights;
+
+	/**
+	 * Add inconsistencies and duplicates to an existing dataset instead of
+	 * generating a new one
+	 */
+	bool inject_only;
+
+	/**
+	 * Lines per chunk. If 0, chunks hold one block
+	 */
+	unsigned long chunk_lines;
+
+	/**
+	 * Words per chunk. If 0, chunks span all the words of a line
+	 */
+	unsigned long chunk_words;
+
+	/**
+	 * Chunk cache size in MB
+	 */
+	double chunk_cache_mb;
+
+	/**
+	 * Compress chunks in the worker threads and write them directly
+	 */
+	bool direct_chunks;
+
+	/**
+	 * Build the file in memory and write it to disk when closed
+	 */
+	bool in_memory;
+
+	/**
+	 * Create the file with block alignment, early allocation, no fill
+	 * values, large metadata blocks and the latest format
+	 */
+	bool io_profile;
+
+	/**
+	 * Add n_observations lines to an existing dataset
+	 */
+	bool append;
+
+	/**
+	 * Continue an interrupted run from its last checkpoint
+	 */
+	bool resume;
+
+	/**
+	 * Seconds between checkpoints. 0 checkpoints every block
+	 */
+	double checkpoint_s;
+
+	/**
+	 * File for the JSON summary of the run, or NULL
+	 */
+	const char* metrics_json;
+
+	/**
+	 * Also write the attributes as lines in DM_COLUMN_DATA
+	 */
+	bool column_data;
 } clargs_t;
 
 /**
@@ -124,4 +278,12 @@ typedef struct clargs_t {
  */
 int read_args(int argc, char** argv, clargs_t* args);
 
+/**
+ * Reads n_classes weights from value. If value names a readable file the
+ * weights are read from it, otherwise value is the list itself. Weights are
+ * separated by commas or whitespace
+ */
+int read_class_weights(const char* value, const unsigned long n_classes,
+					   double* weights);
+
 #endif
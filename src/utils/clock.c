@@ -0,0 +1,20 @@
+/*
+ ============================================================================
+ Name        : utils/clock.c
+ Author      : Eduardo Ribeiro
+ Description : Monotonic clock for timing
+ ============================================================================
+ */
+
+#include "utils/clock.h"
+
+#include <stdint.h>
+#include <time.h>
+
+uint64_t clock_ns(void)
+{
+	struct timespec tick;
+	clock_gettime(CLOCK_MONOTONIC, &tick);
+
+	return (uint64_t) tick.tv_sec * 1000000000 + (uint64_t) tick.tv_nsec;
+}
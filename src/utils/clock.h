@@ -0,0 +1,19 @@
+/*
+ ============================================================================
+ Name        : utils/clock.h
+ Author      : Eduardo Ribeiro
+ Description : Monotonic clock for timing
+ ============================================================================
+ */
+
+#ifndef UTILS_CLOCK_H
+#define UTILS_CLOCK_H
+
+#include <stdint.h>
+
+/**
+ * Monotonic time in nanoseconds
+ */
+uint64_t clock_ns(void);
+
+#endif
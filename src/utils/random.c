@@ -0,0 +1,565 @@
+/*
+ ============================================================================
+ Name        : utils/random.c
+ Author      : Eduardo Ribeiro
+ Description : Random number and random bit generation
+ ============================================================================
+ */
+
+#include "utils/random.h"
+
+#include "types/bernoulli_t.h"
+#include "types/rng_t.h"
+#include "types/word_t.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Widest vector kernel available for this build
+ */
+#if !defined(RANDOM_FORCE_SCALAR) && defined(__AVX512F__)
+#define RANDOM_AVX512
+#elif !defined(RANDOM_FORCE_SCALAR) && defined(__AVX2__)
+#define RANDOM_AVX2
+#endif
+
+#if defined(RANDOM_AVX512) || defined(RANDOM_AVX2)
+#include <immintrin.h>
+#endif
+
+/**
+ * Philox4x32 constants
+ */
+#define PHILOX_M0 0xD2511F53U
+#define PHILOX_M1 0xCD9E8D57U
+#define PHILOX_W0 0x9E3779B9U
+#define PHILOX_W1 0xBB67AE85U
+#define PHILOX_ROUNDS 10
+
+void philox4x32(const uint32_t key[2], const uint32_t counter[4],
+				uint32_t out[4])
+{
+	uint32_t k0 = key[0];
+	uint32_t k1 = key[1];
+
+	uint32_t c0 = counter[0];
+	uint32_t c1 = counter[1];
+	uint32_t c2 = counter[2];
+	uint32_t c3 = counter[3];
+
+	for (uint8_t round = 0; round < PHILOX_ROUNDS; round++) {
+		uint64_t p0 = (uint64_t) PHILOX_M0 * c0;
+		uint64_t p1 = (uint64_t) PHILOX_M1 * c2;
+
+		c0 = (uint32_t) (p1 >> 32) ^ c1 ^ k0;
+		c1 = (uint32_t) p1;
+		c2 = (uint32_t) (p0 >> 32) ^ c3 ^ k1;
+		c3 = (uint32_t) p0;
+
+		k0 += PHILOX_W0;
+		k1 += PHILOX_W1;
+	}
+
+	out[0] = c0;
+	out[1] = c1;
+	out[2] = c2;
+	out[3] = c3;
+}
+
+/**
+ * Sets the counter for block n_block of the stream
+ */
+static void rng_block_counter(const rng_t* rng, const uint64_t n_block,
+							  uint32_t counter[4])
+{
+	counter[0] = (uint32_t) n_block;
+	counter[1] = (rng->counter[1] & 0xFF000000U)
+		| ((uint32_t) (n_block >> 32) & 0x00FFFFFFU);
+	counter[2] = rng->counter[2];
+	counter[3] = rng->counter[3];
+}
+
+/**
+ * Generates the block holding the current position
+ */
+static void rng_generate_block(rng_t* rng)
+{
+	uint32_t out[4];
+
+	rng_block_counter(rng, rng->position >> 1, rng->counter);
+
+	philox4x32(rng->key, rng->counter, out);
+
+	rng->block[0] = ((uint64_t) out[0] << 32) | out[1];
+	rng->block[1] = ((uint64_t) out[2] << 32) | out[3];
+}
+
+/**
+ * Generates n_blocks consecutive blocks starting at block first.
+ * Each block holds two draws
+ */
+static void philox_blocks_scalar(const rng_t* rng, const uint64_t first,
+								 const uint64_t n_blocks, uint64_t* draws)
+{
+	uint32_t counter[4];
+	uint32_t out[4];
+
+	for (uint64_t b = 0; b < n_blocks; b++) {
+		rng_block_counter(rng, first + b, counter);
+
+		philox4x32(rng->key, counter, out);
+
+		draws[2 * b] = ((uint64_t) out[0] << 32) | out[1];
+		draws[2 * b + 1] = ((uint64_t) out[2] << 32) | out[3];
+	}
+}
+
+#if defined(RANDOM_AVX2)
+#define PHILOX_LANES_AVX2 8
+
+/**
+ * 32x32 -> 64 bit multiplication of the 8 lanes of a by m
+ */
+static void philox_mulhilo_avx2(const __m256i a, const __m256i m, __m256i* hi,
+								__m256i* lo)
+{
+	// _mm256_mul_epu32 only multiplies the even lanes
+	__m256i even = _mm256_mul_epu32(a, m);
+	__m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), m);
+
+	*lo = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+	*hi = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xAA);
+}
+
+/**
+ * Same as philox_blocks_scalar, 8 blocks at a time
+ */
+static void philox_blocks_avx2(const rng_t* rng, const uint64_t first,
+							   const uint64_t n_blocks, uint64_t* draws)
+{
+	const __m256i m0 = _mm256_set1_epi32((int) PHILOX_M0);
+	const __m256i m1 = _mm256_set1_epi32((int) PHILOX_M1);
+	const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+	uint32_t counter[4];
+
+	uint64_t b = 0;
+
+	for (; b + PHILOX_LANES_AVX2 <= n_blocks; b += PHILOX_LANES_AVX2) {
+		if ((uint32_t) (first + b) > UINT32_MAX - PHILOX_LANES_AVX2) {
+			// The low counter word would wrap inside the batch
+			break;
+		}
+
+		rng_block_counter(rng, first + b, counter);
+
+		__m256i c0 = _mm256_add_epi32(_mm256_set1_epi32((int) counter[0]),
+									  lanes);
+		__m256i c1 = _mm256_set1_epi32((int) counter[1]);
+		__m256i c2 = _mm256_set1_epi32((int) counter[2]);
+		__m256i c3 = _mm256_set1_epi32((int) counter[3]);
+
+		uint32_t k0 = rng->key[0];
+		uint32_t k1 = rng->key[1];
+
+		for (uint8_t round = 0; round < PHILOX_ROUNDS; round++) {
+			__m256i hi0, lo0, hi1, lo1;
+
+			philox_mulhilo_avx2(c0, m0, &hi0, &lo0);
+			philox_mulhilo_avx2(c2, m1, &hi1, &lo1);
+
+			c0 = _mm256_xor_si256(_mm256_xor_si256(hi1, c1),
+								  _mm256_set1_epi32((int) k0));
+			c1 = lo1;
+			c2 = _mm256_xor_si256(_mm256_xor_si256(hi0, c3),
+								  _mm256_set1_epi32((int) k1));
+			c3 = lo0;
+
+			k0 += PHILOX_W0;
+			k1 += PHILOX_W1;
+		}
+
+		// Draws are (c0 << 32 | c1) and (c2 << 32 | c3) of each block
+		__m256i a_lo = _mm256_unpacklo_epi32(c1, c0);
+		__m256i a_hi = _mm256_unpackhi_epi32(c1, c0);
+		__m256i b_lo = _mm256_unpacklo_epi32(c3, c2);
+		__m256i b_hi = _mm256_unpackhi_epi32(c3, c2);
+
+		// Blocks 0 4, 1 5, 2 6 and 3 7
+		__m256i x0 = _mm256_unpacklo_epi64(a_lo, b_lo);
+		__m256i x1 = _mm256_unpackhi_epi64(a_lo, b_lo);
+		__m256i x2 = _mm256_unpacklo_epi64(a_hi, b_hi);
+		__m256i x3 = _mm256_unpackhi_epi64(a_hi, b_hi);
+
+		__m256i* out = (__m256i*) (draws + 2 * b);
+		_mm256_storeu_si256(out, _mm256_permute2x128_si256(x0, x1, 0x20));
+		_mm256_storeu_si256(out + 1, _mm256_permute2x128_si256(x2, x3, 0x20));
+		_mm256_storeu_si256(out + 2, _mm256_permute2x128_si256(x0, x1, 0x31));
+		_mm256_storeu_si256(out + 3, _mm256_permute2x128_si256(x2, x3, 0x31));
+	}
+
+	philox_blocks_scalar(rng, first + b, n_blocks - b, draws + 2 * b);
+}
+#endif
+
+#if defined(RANDOM_AVX512)
+#define PHILOX_LANES_AVX512 16
+
+/**
+ * 32x32 -> 64 bit multiplication of the 16 lanes of a by m
+ */
+static void philox_mulhilo_avx512(const __m512i a, const __m512i m,
+								  __m512i* hi, __m512i* lo)
+{
+	// _mm512_mul_epu32 only multiplies the even lanes
+	__m512i even = _mm512_mul_epu32(a, m);
+	__m512i odd = _mm512_mul_epu32(_mm512_srli_epi64(a, 32), m);
+
+	*lo = _mm512_mask_blend_epi32(0xAAAA, even, _mm512_slli_epi64(odd, 32));
+	*hi = _mm512_mask_blend_epi32(0xAAAA, _mm512_srli_epi64(even, 32), odd);
+}
+
+/**
+ * Same as philox_blocks_scalar, 16 blocks at a time
+ */
+static void philox_blocks_avx512(const rng_t* rng, const uint64_t first,
+								 const uint64_t n_blocks, uint64_t* draws)
+{
+	const __m512i m0 = _mm512_set1_epi32((int) PHILOX_M0);
+	const __m512i m1 = _mm512_set1_epi32((int) PHILOX_M1);
+	const __m512i lanes = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10,
+											11, 12, 13, 14, 15);
+
+	uint32_t counter[4];
+
+	uint64_t b = 0;
+
+	for (; b + PHILOX_LANES_AVX512 <= n_blocks; b += PHILOX_LANES_AVX512) {
+		if ((uint32_t) (first + b) > UINT32_MAX - PHILOX_LANES_AVX512) {
+			// The low counter word would wrap inside the batch
+			break;
+		}
+
+		rng_block_counter(rng, first + b, counter);
+
+		__m512i c0 = _mm512_add_epi32(_mm512_set1_epi32((int) counter[0]),
+									  lanes);
+		__m512i c1 = _mm512_set1_epi32((int) counter[1]);
+		__m512i c2 = _mm512_set1_epi32((int) counter[2]);
+		__m512i c3 = _mm512_set1_epi32((int) counter[3]);
+
+		uint32_t k0 = rng->key[0];
+		uint32_t k1 = rng->key[1];
+
+		for (uint8_t round = 0; round < PHILOX_ROUNDS; round++) {
+			__m512i hi0, lo0, hi1, lo1;
+
+			philox_mulhilo_avx512(c0, m0, &hi0, &lo0);
+			philox_mulhilo_avx512(c2, m1, &hi1, &lo1);
+
+			c0 = _mm512_xor_si512(_mm512_xor_si512(hi1, c1),
+								  _mm512_set1_epi32((int) k0));
+			c1 = lo1;
+			c2 = _mm512_xor_si512(_mm512_xor_si512(hi0, c3),
+								  _mm512_set1_epi32((int) k1));
+			c3 = lo0;
+
+			k0 += PHILOX_W0;
+			k1 += PHILOX_W1;
+		}
+
+		// Draws are (c0 << 32 | c1) and (c2 << 32 | c3) of each block
+		__m512i a_lo = _mm512_unpacklo_epi32(c1, c0);
+		__m512i a_hi = _mm512_unpackhi_epi32(c1, c0);
+		__m512i b_lo = _mm512_unpacklo_epi32(c3, c2);
+		__m512i b_hi = _mm512_unpackhi_epi32(c3, c2);
+
+		// Blocks 0 4 8 12, 1 5 9 13, 2 6 10 14 and 3 7 11 15
+		__m512i x0 = _mm512_unpacklo_epi64(a_lo, b_lo);
+		__m512i x1 = _mm512_unpackhi_epi64(a_lo, b_lo);
+		__m512i x2 = _mm512_unpacklo_epi64(a_hi, b_hi);
+		__m512i x3 = _mm512_unpackhi_epi64(a_hi, b_hi);
+
+		// 4x4 transpose of the 128 bit lanes
+		__m512i t0 = _mm512_shuffle_i64x2(x0, x1, 0x44);
+		__m512i t1 = _mm512_shuffle_i64x2(x2, x3, 0x44);
+		__m512i t2 = _mm512_shuffle_i64x2(x0, x1, 0xEE);
+		__m512i t3 = _mm512_shuffle_i64x2(x2, x3, 0xEE);
+
+		uint64_t* out = draws + 2 * b;
+		_mm512_storeu_si512((void*) out, _mm512_shuffle_i64x2(t0, t1, 0x88));
+		_mm512_storeu_si512((void*) (out + 8),
+							_mm512_shuffle_i64x2(t0, t1, 0xDD));
+		_mm512_storeu_si512((void*) (out + 16),
+							_mm512_shuffle_i64x2(t2, t3, 0x88));
+		_mm512_storeu_si512((void*) (out + 24),
+							_mm512_shuffle_i64x2(t2, t3, 0xDD));
+	}
+
+	philox_blocks_scalar(rng, first + b, n_blocks - b, draws + 2 * b);
+}
+#endif
+
+#if defined(RANDOM_AVX512)
+#define philox_blocks philox_blocks_avx512
+#define PHILOX_KERNEL "avx512"
+#elif defined(RANDOM_AVX2)
+#define philox_blocks philox_blocks_avx2
+#define PHILOX_KERNEL "avx2"
+#elif defined(RANDOM_FORCE_SCALAR)
+#define philox_blocks philox_blocks_scalar
+#define PHILOX_KERNEL "scalar (forced)"
+#else
+#define philox_blocks philox_blocks_scalar
+#define PHILOX_KERNEL "scalar"
+#endif
+
+/**
+ * Fills draws with the next n draws of the stream using blocks_fn for the
+ * whole blocks
+ */
+static void rng_fill_with(rng_t* rng, uint64_t* draws, const uint64_t n,
+						  void (*blocks_fn)(const rng_t*, const uint64_t,
+											const uint64_t, uint64_t*))
+{
+	uint64_t i = 0;
+
+	// Finish the current block
+	if ((rng->position & 1) && n > 0) {
+		draws[i++] = rng_next(rng);
+	}
+
+	uint64_t n_blocks = (n - i) / 2;
+
+	blocks_fn(rng, rng->position >> 1, n_blocks, draws + i);
+
+	i += 2 * n_blocks;
+	rng->position += 2 * n_blocks;
+
+	// Start a new block and keep its second half for the next draw
+	if (i < n) {
+		draws[i] = rng_next(rng);
+	}
+}
+
+void rng_init(rng_t* rng, const uint64_t seed, const uint8_t domain,
+			  const uint64_t stream)
+{
+	rng->key[0] = (uint32_t) seed;
+	rng->key[1] = (uint32_t) (seed >> 32);
+
+	// Positions use the lower 56 bits, the domain the upper 8
+	rng->counter[0] = 0;
+	rng->counter[1] = (uint32_t) domain << 24;
+	rng->counter[2] = (uint32_t) stream;
+	rng->counter[3] = (uint32_t) (stream >> 32);
+
+	rng->position = 0;
+}
+
+void rng_seek(rng_t* rng, const uint64_t position)
+{
+	rng->position = position;
+
+	if (position & 1) {
+		// First draw comes from the middle of a block
+		rng_generate_block(rng);
+	}
+}
+
+uint64_t rng_next(rng_t* rng)
+{
+	if ((rng->position & 1) == 0) {
+		rng_generate_block(rng);
+	}
+
+	return rng->block[rng->position++ & 1];
+}
+
+void rng_fill(rng_t* rng, uint64_t* draws, const uint64_t n)
+{
+	rng_fill_with(rng, draws, n, philox_blocks);
+}
+
+void rng_fill_scalar(rng_t* rng, uint64_t* draws, const uint64_t n)
+{
+	rng_fill_with(rng, draws, n, philox_blocks_scalar);
+}
+
+const char* rng_kernel(void)
+{
+	return PHILOX_KERNEL;
+}
+
+uint32_t rng_bounded(const uint64_t r, const uint32_t n)
+{
+	return (uint32_t) (((r >> 32) * n) >> 32);
+}
+
+void bernoulli_init(bernoulli_t* bernoulli,
+					const unsigned char probability_attribute_set)
+{
+	bernoulli->expansion = 0;
+	bernoulli->n_draws = 0;
+	bernoulli->constant = 0;
+	bernoulli->sparse = false;
+	bernoulli->log_q = 0;
+
+	if (probability_attribute_set == 0) {
+		return;
+	}
+
+	if (probability_attribute_set >= 100) {
+		bernoulli->constant = ~((word_t) 0);
+		return;
+	}
+
+	// Probability in fixed point, rounded to the nearest value
+	uint32_t p = ((uint32_t) probability_attribute_set << BERNOULLI_PRECISION)
+		+ 50;
+	p /= 100;
+
+	uint8_t n_draws = BERNOULLI_PRECISION;
+
+	// Trailing zeros would only AND words into an empty result
+	while ((p & 1) == 0) {
+		p >>= 1;
+		n_draws--;
+	}
+
+	bernoulli->expansion = p;
+	bernoulli->n_draws = n_draws;
+
+	if (probability_attribute_set < BERNOULLI_SPARSE_THRESHOLD) {
+		bernoulli->sparse = true;
+		bernoulli->log_q = log1p(-(double) probability_attribute_set / 100.0);
+	}
+}
+
+/**
+ * Combines n_draws draws into one word following the binary expansion of p
+ */
+static word_t bernoulli_combine(const bernoulli_t* bernoulli,
+								const uint64_t* draws)
+{
+	// The least significant bit is always 1: 0 | r == r
+	word_t word = draws[0];
+	uint32_t expansion = bernoulli->expansion >> 1;
+
+	for (uint8_t i = 1; i < bernoulli->n_draws; i++) {
+		if (expansion & 1) {
+			word |= draws[i];
+		} else {
+			word &= draws[i];
+		}
+
+		expansion >>= 1;
+	}
+
+	return word;
+}
+
+word_t bernoulli_word(const bernoulli_t* bernoulli, rng_t* rng)
+{
+	if (bernoulli->n_draws == 0) {
+		return bernoulli->constant;
+	}
+
+	uint64_t draws[BERNOULLI_PRECISION];
+
+	for (uint8_t i = 0; i < bernoulli->n_draws; i++) {
+		draws[i] = rng_next(rng);
+	}
+
+	return bernoulli_combine(bernoulli, draws);
+}
+
+void bernoulli_fill(const bernoulli_t* bernoulli, rng_t* rng, word_t* words,
+					const uint32_t n_words)
+{
+	if (bernoulli->n_draws == 0) {
+		for (uint32_t i = 0; i < n_words; i++) {
+			words[i] = bernoulli->constant;
+		}
+
+		return;
+	}
+
+	// Draws are generated in batches so the vector kernels stay busy
+	uint64_t draws[BERNOULLI_BATCH_DRAWS];
+	uint32_t words_per_batch = BERNOULLI_BATCH_DRAWS / bernoulli->n_draws;
+
+	for (uint32_t i = 0; i < n_words; i += words_per_batch) {
+		uint32_t n = n_words - i;
+		if (n > words_per_batch) {
+			n = words_per_batch;
+		}
+
+		rng_fill(rng, draws, (uint64_t) n * bernoulli->n_draws);
+
+		for (uint32_t w = 0; w < n; w++) {
+			words[i + w]
+				= bernoulli_combine(bernoulli, draws + w * bernoulli->n_draws);
+		}
+	}
+}
+
+/**
+ * Sets each bit with geometric skips between set bits
+ */
+static void bernoulli_fill_sparse(const bernoulli_t* bernoulli, rng_t* rng,
+								  word_t* words, const uint32_t n_bits)
+{
+	memset(words, 0, sizeof(word_t) * ((n_bits + WORD_BITS - 1) / WORD_BITS));
+
+	uint64_t draws[BERNOULLI_SPARSE_BATCH_DRAWS];
+	uint32_t next_draw = BERNOULLI_SPARSE_BATCH_DRAWS;
+
+	uint64_t bit = 0;
+
+	while (true) {
+		if (next_draw == BERNOULLI_SPARSE_BATCH_DRAWS) {
+			rng_fill(rng, draws, BERNOULLI_SPARSE_BATCH_DRAWS);
+			next_draw = 0;
+		}
+
+		// Uniform in (0, 1]
+		double u = (double) ((draws[next_draw++] >> 11) + 1) * 0x1.0p-53;
+
+		// Number of unset bits before the next set one
+		bit += (uint64_t) (log(u) / bernoulli->log_q);
+
+		if (bit >= n_bits) {
+			break;
+		}
+
+		words[bit / WORD_BITS] |= (word_t) 1 << (WORD_BITS - 1 - bit % WORD_BITS);
+
+		bit++;
+	}
+}
+
+void bernoulli_fill_bits(const bernoulli_t* bernoulli, rng_t* rng,
+						 word_t* words, const uint32_t n_bits)
+{
+	if (bernoulli->sparse) {
+		bernoulli_fill_sparse(bernoulli, rng, words, n_bits);
+		return;
+	}
+
+	// How many words are fully filled
+	uint32_t n_full_words = n_bits / WORD_BITS;
+
+	// How many bits remain on last word
+	uint8_t n_bits_on_last_word = n_bits % WORD_BITS;
+
+	bernoulli_fill(bernoulli, rng, words, n_full_words);
+
+	// Fill remaining bits on last word, starting from the most significant bit
+	if (n_bits_on_last_word > 0) {
+		words[n_full_words] = bernoulli_word(bernoulli, rng)
+			& ~(((word_t) ~0LU) >> n_bits_on_last_word);
+	}
+}
@@ -0,0 +1,136 @@
+/*
+ ============================================================================
+ Name        : utils/random.h
+ Author      : Eduardo Ribeiro
+ Description : Random number and random bit generation
+ ============================================================================
+ */
+
+#ifndef UTILS_RANDOM_H
+#define UTILS_RANDOM_H
+
+#include "types/bernoulli_t.h"
+#include "types/rng_t.h"
+#include "types/word_t.h"
+
+#include <stdint.h>
+
+/**
+ * Number of bits used to represent the probability of a bit being set.
+ * The generated probability is within 2^-BERNOULLI_PRECISION of the requested
+ * one
+ */
+#define BERNOULLI_PRECISION 16
+
+/**
+ * Below this probability (in %) set bits are placed with geometric skips,
+ * so the cost follows the number of set bits instead of the number of bits
+ */
+#define BERNOULLI_SPARSE_THRESHOLD 6
+
+/**
+ * Number of draws generated at once by bernoulli_fill
+ */
+#define BERNOULLI_BATCH_DRAWS 512
+
+/**
+ * Number of draws generated at once in sparse mode
+ */
+#define BERNOULLI_SPARSE_BATCH_DRAWS 64
+
+/**
+ * Independent random streams. Every stream is addressed by
+ * (seed, domain, stream index, position), so any draw can be reproduced
+ * without generating the ones before it
+ */
+#define RNG_DOMAIN_ATTRIBUTES 0
+#define RNG_DOMAIN_CLASS 1
+#define RNG_DOMAIN_INJECTIONS 2
+
+/**
+ * Philox4x32-10 block function
+ * Salmon et al., "Parallel random numbers: as easy as 1, 2, 3", SC'11
+ */
+void philox4x32(const uint32_t key[2], const uint32_t counter[4],
+				uint32_t out[4]);
+
+/**
+ * Positions the generator at the first draw of the stream identified by
+ * (seed, domain, stream)
+ */
+void rng_init(rng_t* rng, const uint64_t seed, const uint8_t domain,
+			  const uint64_t stream);
+
+/**
+ * Moves the generator to draw number position of its stream
+ */
+void rng_seek(rng_t* rng, const uint64_t position);
+
+/**
+ * Returns the next 64 random bits
+ */
+uint64_t rng_next(rng_t* rng);
+
+/**
+ * Fills draws with the next n draws, the same values n calls to rng_next
+ * would return. Uses the AVX-512 or AVX2 kernel when the build targets them
+ * (make release) unless RANDOM_FORCE_SCALAR is defined
+ */
+void rng_fill(rng_t* rng, uint64_t* draws, const uint64_t n);
+
+/**
+ * Same as rng_fill, always using the scalar kernel.
+ * Reference to check the vector kernels against
+ */
+void rng_fill_scalar(rng_t* rng, uint64_t* draws, const uint64_t n);
+
+/**
+ * Name of the kernel used by rng_fill
+ */
+const char* rng_kernel(void);
+
+/**
+ * Maps 64 random bits to [0, n) with a multiply and a shift. The bias is at
+ * most n / 2^32, against up to 50% for rand() % n with a small RAND_MAX
+ * Lemire, "Fast random integer generation in an interval", 2019
+ */
+uint32_t rng_bounded(const uint64_t r, const uint32_t n);
+
+/**
+ * Prepares the generator to set each bit with probability
+ * probability_attribute_set / 100. Probabilities under
+ * BERNOULLI_SPARSE_THRESHOLD use the sparse mode
+ */
+void bernoulli_init(bernoulli_t* bernoulli,
+					const unsigned char probability_attribute_set);
+
+/**
+ * Returns one word where each bit is set with the configured probability.
+ *
+ * The random words are combined following the binary expansion of p,
+ * starting from the least significant bit: a 1 ORs the next random word in,
+ * raising the probability to (1 + p') / 2, and a 0 ANDs it in, lowering it to
+ * p' / 2. After the most significant bit every bit of the result is set with
+ * probability p, using at most BERNOULLI_PRECISION draws instead of one draw
+ * per bit.
+ */
+word_t bernoulli_word(const bernoulli_t* bernoulli, rng_t* rng);
+
+/**
+ * Fills n_words words with random bits
+ */
+void bernoulli_fill(const bernoulli_t* bernoulli, rng_t* rng, word_t* words,
+					const uint32_t n_words);
+
+/**
+ * Fills the first n_bits bits of words, most significant bit first, and
+ * clears the rest of the last word.
+ *
+ * In sparse mode the gap to the next set bit is drawn from the geometric
+ * distribution, floor(log(u) / log(1 - p)), so only set bits cost a draw.
+ * Otherwise whole words come from bernoulli_fill
+ */
+void bernoulli_fill_bits(const bernoulli_t* bernoulli, rng_t* rng,
+						 word_t* words, const uint32_t n_bits);
+
+#endif // UTILS_RANDOM_H